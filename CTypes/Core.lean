@@ -14,7 +14,13 @@
 -- limitations under the License.
 --
 
+import CTypes.Core.Arena
+import CTypes.Core.Async
+import CTypes.Core.Buffer
 import CTypes.Core.Closure
+import CTypes.Core.FieldPath
+import CTypes.Core.Function
 import CTypes.Core.Library
+import CTypes.Core.Mapped
 import CTypes.Core.Types
 import CTypes.Core.Utils
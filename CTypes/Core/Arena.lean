@@ -0,0 +1,76 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes.Core.Types
+
+set_option relaxedAutoImplicit false
+
+namespace CTypes.Core
+
+/--
+  Arena for C memory that is released all at once.
+
+  Allocating a block only bumps an offset in the current chunk. Blocks are never
+  freed one by one. They are released by `reset` or when the arena is finalized.
+  This is useful for data structures that are built for a single call.
+-/
+opaque Arena.Nonempty : NonemptyType
+def Arena : Type := Arena.Nonempty.type
+instance : Nonempty Arena := Arena.Nonempty.property
+
+namespace Arena
+
+  @[extern "Arena_mk"]
+  private opaque create (chunkSize : @&Nat) : IO Arena
+
+  /--
+    Create an arena that reserves memory in chunks of `chunkSize` bytes.
+    Larger blocks get their own chunk.
+  -/
+  def mk (chunkSize : Nat := 4096) : IO Arena := create chunkSize
+
+  @[extern "Arena_alloc"]
+  private opaque allocImpl (arena : @&Arena) (size : @&Nat) (align : @&Nat) : IO Pointer
+
+  /--
+    Allocate an uninitialized block of `size` bytes.
+
+    `align` has to be a power of two. The pointer and pointers derived from it with
+    `+` and `-` keep the arena alive, but they are invalid after `reset`.
+  -/
+  def alloc (arena : Arena) (size : Nat) (align : Nat := 16) : IO Pointer :=
+    allocImpl arena size align
+
+  /-- Allocate a block for a value and write the value to it. -/
+  @[extern "Arena_allocValue"]
+  opaque allocValue (arena : @&Arena) (value : @&CValue) : IO Pointer
+
+  /--
+    Release all blocks.
+
+    All pointers into the arena are invalid afterwards. The first chunk is kept for
+    new blocks.
+  -/
+  @[extern "Arena_reset"]
+  opaque reset (arena : @&Arena) : IO Unit
+
+  /-- Get the number of bytes allocated in the arena, including padding. -/
+  @[extern "Arena_used"]
+  opaque used (arena : @&Arena) : IO Nat
+
+end Arena
+
+end CTypes.Core
@@ -0,0 +1,82 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes.Core.Types
+
+set_option relaxedAutoImplicit false
+
+namespace CTypes.Core
+
+/--
+  Statistics of the thread pool for asynchronous calls.
+
+  Times are in nanoseconds. The queue time is the time between submitting a call and
+  the start of its execution.
+-/
+structure AsyncStats where
+  threads      : Nat
+  queueDepth   : Nat
+  queued       : Nat
+  submitted    : Nat
+  completed    : Nat
+  queueTime    : Nat
+  maxQueueTime : Nat
+  execTime     : Nat
+  maxExecTime  : Nat
+deriving Repr
+
+namespace Async
+  /--
+    Set the number of threads and the maximum number of queued calls of the pool.
+
+    The default is 4 threads and 256 queued calls. Calls to `Pointer.callAsync` block
+    while the queue is full.
+  -/
+  @[extern "Async_configure"]
+  opaque configure (threads : @&Nat) (queueDepth : @&Nat) : IO Unit
+
+  /-- Get the statistics of the pool. -/
+  @[extern "Async_stats"]
+  opaque stats : IO AsyncStats
+
+  /-- Resolve the promise of a call. This is called by the worker threads. -/
+  @[export ctypes_async_resolve]
+  private def resolve (promise : IO.Promise (Except IO.Error CValue))
+      (result : Except IO.Error CValue) : BaseIO Unit :=
+    promise.resolve result
+end Async
+
+namespace Pointer
+  @[extern "Pointer_callAsync"]
+  private opaque callAsyncCore (p : @&Pointer) (rtype : @&CType) (args : @&Array CValue)
+    (vargs : @&Array CValue) (promise : @&IO.Promise (Except IO.Error CValue)) : IO Unit
+
+  /--
+    Call the pointer as a function on a separate pool of native threads.
+
+    The arguments are converted before this returns, so errors in the arguments are
+    raised immediately. The call itself doesn't block a Lean thread, which is useful
+    for functions that block for a long time. See `Async.configure` for the size of
+    the pool.
+  -/
+  def callAsync (p : Pointer) (rtype : CType) (args : Array CValue) (vargs : Array CValue)
+      : IO (Task (Except IO.Error CValue)) := do
+    let promise ← IO.Promise.new
+    callAsyncCore p rtype args vargs promise
+    return promise.result
+end Pointer
+
+end CTypes.Core
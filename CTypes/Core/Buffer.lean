@@ -0,0 +1,55 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes.Core.Types
+
+set_option relaxedAutoImplicit false
+
+namespace CTypes.Core
+
+/--
+  Buffer in C memory that is freed when it is finalized.
+
+  Small buffers are taken from free lists of the thread, so allocating and freeing
+  them is cheap.
+-/
+opaque Buffer.Nonempty : NonemptyType
+def Buffer : Type := Buffer.Nonempty.type
+instance : Nonempty Buffer := Buffer.Nonempty.property
+
+namespace Buffer
+
+  @[extern "Buffer_mk"]
+  private opaque alloc (size : @&Nat) (zero : Bool) : IO Buffer
+
+  /-- Allocate a buffer of `size` bytes. It is filled with zeros if `zero` is set. -/
+  def mk (size : Nat) (zero : Bool := true) : IO Buffer := alloc size zero
+
+  /--
+    Get a pointer to the buffer.
+
+    The pointer and pointers derived from it with `+` and `-` keep the buffer alive.
+  -/
+  @[extern "Buffer_pointer"]
+  opaque pointer (buffer : @&Buffer) : Pointer
+
+  /-- Get the size of the buffer in bytes. -/
+  @[extern "Buffer_size"]
+  opaque size (buffer : @&Buffer) : Nat
+
+end Buffer
+
+end CTypes.Core
@@ -22,6 +22,11 @@ namespace CTypes.Core
 
 /--
   Closure object to implement callbacks from C.
+
+  Callbacks can run on any thread. Threads that are not known to the Lean runtime
+  are registered on their first callback. Lean threads are known once they called
+  a foreign function or created a closure through this library; callbacks on other
+  Lean threads that entered C some other way are not supported.
 -/
 opaque Closure.Nonempty : NonemptyType
 def Closure : Type := Closure.Nonempty.type
@@ -29,6 +34,19 @@ instance : Nonempty Closure := Closure.Nonempty.property
 
 def Callback := Array CValue → IO CValue
 
+/--
+  Statistics of the closures.
+
+  `allocated` is the number of trampolines allocated from libffi, of which `available`
+  are unused and kept for new closures. `signatures` is the number of prepared
+  signatures that are shared by the closures.
+-/
+structure ClosurePoolStats where
+  allocated  : Nat
+  available  : Nat
+  signatures : Nat
+deriving Repr
+
 namespace Closure
   /--
     Create a Closure from a signature and a callback function.
@@ -43,6 +61,33 @@ namespace Closure
   @[extern "Closure_mk"]
   opaque mk (rtype : @&CType) (args : @&Array CType) (callback : Callback) : IO Closure
 
+  /-!
+    Closures for fixed signatures.
+
+    The arguments and the return value are passed to the callback directly, without
+    a `CValue` and an `Array`. Pointers are passed as addresses. They are created and
+    deleted like closures from `mk`.
+  -/
+
+  /-- Create a closure `double f(double)`. -/
+  @[extern "Closure_mkDoubleUnary"]
+  opaque mkDoubleUnary (callback : Float → IO Float) : IO Closure
+
+  /-- Create a closure `double f(double, double)`. -/
+  @[extern "Closure_mkDoubleBinary"]
+  opaque mkDoubleBinary (callback : Float → Float → IO Float) : IO Closure
+
+  /--
+    Create a closure `int f(const void *, const void *)`, e.g. for `qsort()`.
+    Results outside of the range of `int` are clamped.
+  -/
+  @[extern "Closure_mkComparator"]
+  opaque mkComparator (callback : USize → USize → IO Int) : IO Closure
+
+  /-- Create a closure `void f(void *)`. -/
+  @[extern "Closure_mkPointerAction"]
+  opaque mkPointerAction (callback : USize → IO Unit) : IO Closure
+
   /--
     Mark the closure for deletion.
 
@@ -51,6 +96,10 @@ namespace Closure
   @[extern "Closure_delete"]
   opaque delete (c : @&Closure) : IO Unit
 
+  /-- Get the statistics of the closures. -/
+  @[extern "Closure_poolStats"]
+  opaque poolStats : IO ClosurePoolStats
+
   /-- Get a pointer to the C function. -/
   @[extern "Closure_pointer"]
   opaque pointer (c : @&Closure) : Pointer
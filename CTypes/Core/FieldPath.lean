@@ -0,0 +1,69 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes.Core.Types
+
+set_option relaxedAutoImplicit false
+
+namespace CTypes.Core
+
+/--
+  Path to a field in nested structs.
+
+  The path is resolved to the offset and the type of the field once, so reading or
+  writing the field doesn't convert the rest of the struct.
+-/
+opaque FieldPath.Nonempty : NonemptyType
+def FieldPath : Type := FieldPath.Nonempty.type
+instance : Nonempty FieldPath := FieldPath.Nonempty.property
+
+namespace FieldPath
+
+  /--
+    Resolve a path of element indices in a struct type.
+
+    `#[1, 2]` is the third element of the second element of `type`. Raises an
+    `IO.Error` exception if an index is out of range or indexes a non-struct type.
+  -/
+  @[extern "FieldPath_mk"]
+  opaque mk (type : @&CType) (path : @&Array Nat) : IO FieldPath
+
+  /-- Get the offset of the field from the start of the outermost struct. -/
+  @[extern "FieldPath_offset"]
+  opaque offset (path : @&FieldPath) : Nat
+
+  /-- Get the type of the field. -/
+  @[extern "FieldPath_type"]
+  opaque type (path : @&FieldPath) : CType
+
+end FieldPath
+
+namespace Pointer
+
+  /-- Read a single field of the struct the pointer points to. -/
+  @[extern "Pointer_readField"]
+  opaque readField (p : @&Pointer) (path : @&FieldPath) : IO CValue
+
+  /--
+    Write a single field of the struct the pointer points to.
+    The value has to have the type of the field.
+  -/
+  @[extern "Pointer_writeField"]
+  opaque writeField (p : @&Pointer) (path : @&FieldPath) (value : @&CValue) : IO Unit
+
+end Pointer
+
+end CTypes.Core
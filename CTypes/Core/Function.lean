@@ -0,0 +1,110 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes.Core.Library
+import CTypes.Core.Types
+
+set_option relaxedAutoImplicit false
+
+namespace CTypes.Core
+
+/--
+  Function pointer with a fixed signature.
+
+  The call interface is prepared once when the object is created, so calling the
+  function only has to convert the arguments. Functions that are called often should
+  use this instead of `Pointer.call`.
+-/
+opaque ForeignFunction.Nonempty : NonemptyType
+def ForeignFunction : Type := ForeignFunction.Nonempty.type
+instance : Nonempty ForeignFunction := ForeignFunction.Nonempty.property
+
+namespace ForeignFunction
+  /--
+    Prepare a pointer for calls with the given signature.
+
+    Like in `Pointer.call`, a nonempty `vargs` prepares the function as a variadic
+    function with `args` as the fixed arguments.
+  -/
+  @[extern "ForeignFunction_mk"]
+  opaque mk (p : @&Pointer) (rtype : @&CType) (args : @&Array CType) (vargs : @&Array CType) : IO ForeignFunction
+
+  /--
+    Like `mk`, but the function is always called with libffi.
+
+    Functions with up to four integer, pointer, `float` or `double` arguments are
+    otherwise called directly. This is only useful to compare both.
+  -/
+  @[extern "ForeignFunction_mkGeneric"]
+  opaque mkGeneric (p : @&Pointer) (rtype : @&CType) (args : @&Array CType) (vargs : @&Array CType) : IO ForeignFunction
+
+  /--
+    Create a non-variadic function for a symbol in a library.
+
+    If the symbol and the signature are listed in the binding manifest (`bindings.txt`),
+    the function is called with a shim that was generated at build time. Otherwise
+    this is the same as `mk`.
+  -/
+  @[extern "ForeignFunction_bind"]
+  opaque bind (lib : @&Library) (name : @&String) (rtype : @&CType) (args : @&Array CType) : IO ForeignFunction
+
+  /--
+    Call the function.
+
+    `args` contains the values of the fixed arguments followed by the variadic
+    arguments. Their types have to match the signature of the function.
+  -/
+  @[extern "ForeignFunction_call"]
+  opaque call (f : @&ForeignFunction) (args : @&Array CValue) : IO CValue
+
+  /--
+    Call the function once for every array of arguments.
+
+    This crosses into C only once. All arguments are checked before the first
+    call, so either all calls are made or none.
+  -/
+  @[extern "ForeignFunction_callBatch"]
+  opaque callBatch (f : @&ForeignFunction) (args : @&Array (Array CValue)) : IO (Array CValue)
+
+  /-- Check if the function is called directly instead of with libffi. -/
+  @[extern "ForeignFunction_isDirect"]
+  opaque isDirect (f : @&ForeignFunction) : Bool
+
+  /-- Check if the function is called with a generated binding. -/
+  @[extern "ForeignFunction_isGenerated"]
+  opaque isGenerated (f : @&ForeignFunction) : Bool
+
+  /-- Get the function pointer. -/
+  @[extern "ForeignFunction_pointer"]
+  opaque pointer (f : @&ForeignFunction) : Pointer
+
+end ForeignFunction
+
+/--
+  Call a non-variadic function once for every array of arguments.
+
+  The signature is derived from the first array and prepared only once.
+-/
+def Pointer.callBatch (p : Pointer) (rtype : CType) (args : Array (Array CValue)) : IO (Array CValue) := do
+  match args[0]? with
+  | none => return #[]
+  | some first =>
+    let f ← ForeignFunction.mk p rtype (first.map CValue.type) #[]
+    f.callBatch args
+
+instance : Repr ForeignFunction := ⟨fun f _ => s!"CTypes.ForeignFunction<{f.pointer.address}>"⟩
+
+end CTypes.Core
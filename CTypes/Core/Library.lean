@@ -46,15 +46,22 @@ namespace Library
     | RTLD_LOCAL
     | RTLD_NODELETE
 
-  /-- Thin wrapper around `dlopen()`. -/
+  /--
+    Open a library with `dlopen()`.
+
+    Libraries that are opened more than once with the same flags share one handle.
+    The handle is closed with `dlclose()` once all libraries that use it and all
+    pointers to their symbols are finalized.
+  -/
   @[extern "Library_mk"]
   opaque mk (path : @&String) (mode : @&ModeFlag) (opts : @&Array OptionFlag) : IO Library
 
   /--
-    Thin wrapper around `dlclose()`.
+    Release the handle of the library before it is finalized.
 
     This should be used carefully and is usually not necessary.
-    Pointers might still depend on the library and get invalidated if it is unloaded.
+    The library is unloaded if no other library uses the same handle. Pointers to
+    symbols are invalidated in that case.
     Note that this function can only be called once for each library and no new
     symbols can be created afterwards.
   -/
@@ -71,6 +78,52 @@ namespace Library
   -/
   @[extern "Library_symbol"]
   opaque symbol (library : @&Library) (name : @&String) : IO Pointer
+
+  /--
+    Get a pointer to a symbol that is looked up when it is used for the first time.
+
+    Creating the pointer doesn't call `dlsym()`, so bindings with many symbols that
+    are rarely used start faster, especially together with `RTLD_LAZY`. Reading,
+    writing or calling the pointer raises an `IO.Error` exception if the symbol
+    doesn't exist. `Pointer.address` is 0 until the symbol is looked up, e.g. with
+    `Pointer.resolve`.
+  -/
+  @[extern "Library_lazySymbol"]
+  opaque lazySymbol (library : @&Library) (name : @&String) : IO Pointer
+
+  /--
+    Get pointers to several symbols at once.
+
+    Symbols that don't exist are `none`. Addresses are cached in the library, so
+    repeated lookups don't call `dlsym()` again.
+  -/
+  @[extern "Library_symbols"]
+  opaque symbols (library : @&Library) (names : @&Array String) : IO (Array (Option Pointer))
+
+  /--
+    Get the names of all symbols that are exported by the library, sorted by name.
+
+    The names are read from the dynamic symbol table once and kept in an index, which
+    is also used by `exportsWithPrefix`, `exportsMatching` and `hasExports`. Symbols
+    of dependencies are not included.
+  -/
+  @[extern "Library_exports"]
+  opaque exports (library : @&Library) : IO (Array String)
+
+  /-- Get the names of the exported symbols that start with `pfx`, sorted by name. -/
+  @[extern "Library_exportsWithPrefix"]
+  opaque exportsWithPrefix (library : @&Library) (pfx : @&String) : IO (Array String)
+
+  /--
+    Get the names of the exported symbols that match a glob pattern, sorted by name.
+    See `man fnmatch` for the syntax.
+  -/
+  @[extern "Library_exportsMatching"]
+  opaque exportsMatching (library : @&Library) (pattern : @&String) : IO (Array String)
+
+  /-- Check which of the names are exported by the library without calling `dlsym()`. -/
+  @[extern "Library_hasExports"]
+  opaque hasExports (library : @&Library) (names : @&Array String) : IO (Array Bool)
 end Library
 
 instance : Repr     Library := ⟨fun lib _ => s!"CTypes.Library<{lib.path}>"⟩
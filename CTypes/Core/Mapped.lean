@@ -0,0 +1,93 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes.Core.Types
+
+set_option relaxedAutoImplicit false
+
+namespace CTypes.Core
+
+/--
+  Region of a file that is mapped into memory with `mmap()`.
+
+  The region is unmapped when it is finalized. The pointer of the region and
+  pointers derived from it with `+` and `-` keep it mapped, so C functions can work
+  on files that are larger than the memory without copying them. Pointers created
+  from an address with `Pointer.mk` don't.
+-/
+opaque MappedRegion.Nonempty : NonemptyType
+def MappedRegion : Type := MappedRegion.Nonempty.type
+instance : Nonempty MappedRegion := MappedRegion.Nonempty.property
+
+namespace MappedRegion
+
+  /-- How the file is mapped. -/
+  inductive Mode where
+    /-- The region can only be read. -/
+    | readOnly
+    /-- Writes are allowed, but they are not visible in the file (`MAP_PRIVATE`). -/
+    | copyOnWrite
+    /-- Writes are written back to the file (`MAP_SHARED`). -/
+    | shared
+
+  /--
+    Hints for the access pattern of a region.
+    See `man madvise` for details.
+  -/
+  inductive Advice where
+    | normal
+    | sequential
+    | random
+    | willNeed
+    | dontNeed
+    | hugePage
+
+  /--
+    Map `length` bytes of a file, starting at `offset`.
+
+    The offset doesn't have to be aligned to pages. A length of 0 maps the rest of the
+    file. Raises an `IO.Error` exception if the region is not part of the file.
+  -/
+  @[extern "MappedRegion_mk"]
+  opaque mkRange (path : @&String) (mode : Mode) (offset length : @&Nat) : IO MappedRegion
+
+  /-- Map a whole file. -/
+  def mk (path : String) (mode : Mode) : IO MappedRegion := mkRange path mode 0 0
+
+  /--
+    Get a pointer to the start of the region.
+
+    The pointer and pointers derived from it with `+` and `-` keep the region
+    mapped.
+  -/
+  @[extern "MappedRegion_pointer"]
+  opaque pointer (region : @&MappedRegion) : Pointer
+
+  /-- Get the size of the region in bytes. -/
+  @[extern "MappedRegion_size"]
+  opaque size (region : @&MappedRegion) : Nat
+
+  /-- Give the kernel a hint about how the region is accessed, using `madvise()`. -/
+  @[extern "MappedRegion_advise"]
+  opaque advise (region : @&MappedRegion) (advice : Advice) : IO Unit
+
+  /-- Write changes of a shared region back to the file, using `msync()`. -/
+  @[extern "MappedRegion_sync"]
+  opaque sync (region : @&MappedRegion) : IO Unit
+
+end MappedRegion
+
+end CTypes.Core
@@ -32,10 +32,37 @@ namespace Pointer
   /-- NULL pointer. -/
   def null : Pointer := Pointer.mk 0
 
-  /-- Get the address as an integer. -/
+  /--
+    Get the address as an integer.
+
+    Lazy symbols are not looked up, their address is 0 until they are resolved with
+    `resolve` or used.
+  -/
   @[extern "Pointer_address"]
   opaque address (p : @&Pointer) : USize
 
+  /--
+    Add `delta` bytes to the address, wrapping around like `USize`.
+
+    The new pointer keeps the memory alive like the original one, e.g. a buffer or
+    library. The offset of a lazy symbol that wasn't looked up yet is looked up when
+    it is used.
+  -/
+  @[extern "Pointer_offset"]
+  opaque offset (p : @&Pointer) (delta : USize) : Pointer
+
+  /-- Check if the address is known, i.e. the pointer isn't an unused lazy symbol. -/
+  @[extern "Pointer_isResolved"]
+  opaque isResolved (p : @&Pointer) : BaseIO Bool
+
+  /--
+    Look up a lazy symbol and get the address.
+
+    Raises an `IO.Error` exception if the symbol doesn't exist.
+  -/
+  @[extern "Pointer_resolve"]
+  opaque resolve (p : @&Pointer) : IO USize
+
 end Pointer
 
 instance : Inhabited Pointer := ⟨Pointer.mk 0⟩
@@ -43,17 +70,17 @@ instance : Repr Pointer := ⟨fun p _ => s!"CTypes.Pointer<{p.address}>"⟩
 instance : BEq Pointer := ⟨fun a b => a.address == b.address⟩
 
 @[default_instance high]
-instance : HAdd Pointer Nat Pointer := ⟨fun p n => .mk (p.address + USize.ofNat n)⟩
+instance : HAdd Pointer Nat Pointer := ⟨fun p n => p.offset (USize.ofNat n)⟩
 @[default_instance high]
-instance : HSub Pointer Nat Pointer := ⟨fun p n => .mk (p.address - USize.ofNat n)⟩
+instance : HSub Pointer Nat Pointer := ⟨fun p n => p.offset (0 - USize.ofNat n)⟩
 @[default_instance high]
 instance : HAdd Pointer Int Pointer := ⟨fun p n =>
-  if n >= 0 then .mk (p.address + USize.ofNat n.toNat)
-  else           .mk (p.address - USize.ofNat n.natAbs)⟩
+  if n >= 0 then p.offset (USize.ofNat n.toNat)
+  else           p.offset (0 - USize.ofNat n.natAbs)⟩
 @[default_instance high]
 instance : HSub Pointer Int Pointer := ⟨fun p n =>
-  if n >= 0 then .mk (p.address - USize.ofNat n.toNat)
-  else           .mk (p.address + USize.ofNat n.natAbs)⟩
+  if n >= 0 then p.offset (0 - USize.ofNat n.toNat)
+  else           p.offset (USize.ofNat n.natAbs)⟩
 
 /--
   Types in C and `libffi`.
@@ -88,7 +115,7 @@ namespace CType
   @[extern "CType_size"]
   opaque size (type : @&CType) : Nat
 
-  /-- Get struct offsets. -/
+  /-- Get struct offsets. They are computed only once for every type. -/
   @[extern "CType_offsets"]
   opaque offsets (type : @&CType) : Array Nat
 
@@ -143,13 +170,7 @@ deriving Inhabited, Repr, BEq
 
 namespace CValue
 
-  /--
-    Get the type of a `CValue`.
-
-    IMPORTANT: Do not use this function directly in C++. The `CValue` argument is
-               owned by the function.
-  -/
-  @[export CValue_type__]
+  /-- Get the type of a `CValue`. -/
   partial def type : CValue → CType
     | .void .. => .void
     | .int8 .. => .int8
@@ -232,6 +253,26 @@ namespace CValue
 
 end CValue
 
+/--
+  Argument of `Pointer.callWith`.
+
+  Buffers and strings are passed as pointers to their data without copying them.
+-/
+inductive Argument where
+  | value  (v : CValue)
+  | bytes  (b : ByteArray)
+  | floats (f : FloatArray)
+  | string (s : String)
+deriving Inhabited
+
+/-- Result of `Pointer.callWith`. -/
+structure CallResult where
+  /-- Return value of the function. -/
+  value : CValue
+  /-- Arguments of the call, including all writes of the function to buffers. -/
+  args : Array Argument
+deriving Inhabited
+
 namespace Pointer
 
   /--
@@ -249,6 +290,56 @@ namespace Pointer
   @[extern "Pointer_write"]
   opaque write (p : @&Pointer) (value : @&CValue) : IO Unit
 
+  /-- Copy `count` bytes to a `ByteArray`. -/
+  @[extern "Pointer_readBytes"]
+  opaque readBytes (p : @&Pointer) (count : @&Nat) : IO ByteArray
+
+  /-- Copy the contents of a `ByteArray` to the memory. -/
+  @[extern "Pointer_writeBytes"]
+  opaque writeBytes (p : @&Pointer) (bytes : @&ByteArray) : IO Unit
+
+  /--
+    Convert a C array of `count` numbers to a `FloatArray`.
+
+    `type` is the type of the elements. It has to be an integer type, `float` or
+    `double`.
+  -/
+  @[extern "Pointer_readFloats"]
+  opaque readFloats (p : @&Pointer) (type : @&CType) (count : @&Nat) : IO FloatArray
+
+  /--
+    Convert a `FloatArray` to a C array of numbers.
+
+    `type` is the type of the elements like in `readFloats`. Conversions to integers
+    are truncated towards zero and saturated. NaN is converted to 0.
+  -/
+  @[extern "Pointer_writeFloats"]
+  opaque writeFloats (p : @&Pointer) (type : @&CType) (floats : @&FloatArray) : IO Unit
+
+  @[extern "Pointer_readArray"]
+  private opaque readArrayImpl (p : @&Pointer) (type : @&CType) (count : @&Nat) (stride : @&Nat) : IO (Array CValue)
+
+  @[extern "Pointer_writeArray"]
+  private opaque writeArrayImpl (p : @&Pointer) (type : @&CType) (values : @&Array CValue) (stride : @&Nat) : IO Unit
+
+  /--
+    Read `count` values of the same type.
+
+    The elements are `stride` bytes apart, which is the size of the type for a C
+    array. This is a single call, so the type is only resolved once.
+  -/
+  def readArray (p : Pointer) (type : CType) (count : Nat) (stride : Nat := type.size) : IO (Array CValue) :=
+    readArrayImpl p type count stride
+
+  /--
+    Write values of the same type `stride` bytes apart.
+
+    All values have to be of type `type`. They are checked before the first one is
+    written.
+  -/
+  def writeArray (p : Pointer) (type : CType) (values : Array CValue) (stride : Nat := type.size) : IO Unit :=
+    writeArrayImpl p type values stride
+
   /--
     Call a pointer as a function.
 
@@ -262,6 +353,29 @@ namespace Pointer
   @[extern "Pointer_call"]
   opaque call (p : @&Pointer) (rtype : @&CType) (args : @&Array CValue) (vargs : @&Array CValue) : IO CValue
 
+  /--
+    Call a pointer as a non-variadic function without copying buffers.
+
+    `ByteArray` and `FloatArray` arguments are passed as pointers to their data. They
+    are only copied if they are shared, so the function may modify them in place. The
+    modified buffers are returned in `CallResult.args`. Strings are passed as
+    `const char *` and must not be modified.
+  -/
+  @[extern "Pointer_callWith"]
+  opaque callWith (p : @&Pointer) (rtype : @&CType) (args : Array Argument) : IO CallResult
+
+  /--
+    Call `fn` for every element of an array and store the results in another array.
+
+    `fn` is called as a function `resultType fn(elemType)` with a pointer to each
+    element of the array at `src`. The elements of both arrays are stored back to back
+    with the size of their type. No Lean values are created for the elements.
+
+    `src` and `dst` may be the same if the result is not larger than an element.
+  -/
+  @[extern "Pointer_mapCall"]
+  opaque mapCall (fn src dst : @&Pointer) (count : @&Nat) (elemType resultType : @&CType) : IO Unit
+
 end Pointer
 
 end CTypes.Core
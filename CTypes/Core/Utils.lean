@@ -28,6 +28,8 @@ namespace CTypes.Core
   Buffers created this way should only be freed with the builtin `free`, not one
   loaded from a library. This avoids inconsistencies between different `malloc`
   implementations in libraries.
+
+  `Buffer` should be preferred, because it is freed automatically.
 -/
 @[extern "Utils_malloc"]
 opaque malloc (size : @&Nat) : IO Pointer
@@ -36,4 +38,22 @@ opaque malloc (size : @&Nat) : IO Pointer
 @[extern "Utils_free"]
 opaque free (pointer : @&Pointer) : IO Unit
 
+/--
+  Statistics of the arena that holds the buffers of foreign calls.
+
+  Every thread has its own arena.
+-/
+structure FrameArenaStats where
+  /-- Largest number of bytes in use at the same time. -/
+  highWater : Nat
+  /-- Number of allocations that did not fit into the current chunk. -/
+  overflows : Nat
+  /-- Number of bytes currently reserved by the arena. -/
+  capacity : Nat
+deriving Repr
+
+/-- Get the statistics of the frame arena of the calling thread. -/
+@[extern "Utils_frameArenaStats"]
+opaque frameArenaStats : IO FrameArenaStats
+
 end CTypes.Core
@@ -15,5 +15,7 @@
 --
 
 import Tests.Core.Functions
+import Tests.Core.Library
+import Tests.Core.Mapped
 import Tests.Core.Types
 import Tests.Core.Utils
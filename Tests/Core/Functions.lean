@@ -50,6 +50,130 @@ namespace Tests.Functions
       return
     assertTrue false "foo.call did not fail"
 
+  /-- Pass a struct by value and return one. -/
+  testcase testCallStruct requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "typedef struct { int8_t a; double b; int32_t c; } S;" ++
+                       "S step(S s, int32_t x) { S r = {s.a + 1, s.b * 2, s.c + x}; return r; }"
+    let S := CType.struct #[.int8, .double, .int32]
+    let value ← (← lib["step"]).call S #[.struct #[.int8 1, .double 1.5, .int32 10], .int32 5] #[]
+    assertEqual value (.struct #[.int8 2, .double 3.0, .int32 15]) s!"wrong result: {repr value}"
+
+  /-- Call a function with more arguments than fit into a frame without allocating. -/
+  testcase testCallManyArguments requires (libgen : SharedLibrary) := do
+    let params := ", ".intercalate <| (List.range 20).map fun i => s!"int64_t a{i}"
+    let body := " + ".intercalate <| (List.range 20).map fun i => s!"a{i}"
+    let lib ← libgen $ "int64_t sum(" ++ params ++ ") { return " ++ body ++ "; }"
+    let args := (Array.range 20).map fun i => CValue.int64 i
+    let value ← (← lib["sum"]).call .int64 args #[]
+    assertEqual value (.int64 190) s!"wrong result: {repr value}"
+
+  /-- Call a function with a prepared signature multiple times. -/
+  testcase testForeignFunction requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int64_t add(int32_t a, int64_t b) { return a + b; }"
+    let add ← ForeignFunction.mk (← lib["add"]) .int64 #[.int32, .int64] #[]
+    for i in [0:8] do
+      let value ← add.call #[.int32 i, .int64 100]
+      assertEqual value (.int64 (100 + i)) s!"wrong result: {repr value}"
+
+  testcase testForeignFunctionVariadic requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int sum(int a, ...) {" ++
+                       "    va_list ap; int sum = a; int n;" ++
+                       "    va_start(ap, a);" ++
+                       "    while ((n = va_arg(ap, int)) != 0) sum += n;" ++
+                       "    va_end(ap);" ++
+                       "    return sum;}"
+    let sum ← ForeignFunction.mk (← lib["sum"]) .int #[.int] #[.int, .int, .int]
+    let value ← sum.call #[.int 8, .int 16, .int 32, .int 0]
+    assertEqual value (.int 56)
+
+  /-- Call a function for a batch of arguments. -/
+  testcase testCallBatch requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int64_t mul(int64_t a, int64_t b) { return a * b; }"
+    let args := (Array.range 100).map fun i => #[CValue.int64 i, .int64 3]
+    let results ← (← lib["mul"]).callBatch .int64 args
+    assertEqual results ((Array.range 100).map fun i => CValue.int64 (3 * i))
+
+  /-- Direct calls and calls with libffi give the same results. -/
+  testcase testDirectCall requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int16_t mix(uint8_t a, int8_t b, float c, double d) " ++
+                       "{ return a + b + (int16_t)c + (int16_t)d; }"
+    let types := #[.uint8, .int8, .float, .double]
+    let direct ← ForeignFunction.mk (← lib["mix"]) .int16 types #[]
+    let generic ← ForeignFunction.mkGeneric (← lib["mix"]) .int16 types #[]
+    assertTrue (!generic.isDirect) "generic function is called directly"
+    let args := #[.uint8 200, .int8 (-100), .float (-300.0), .double 50.0]
+    let expected ← generic.call args
+    assertEqual expected (.int16 (-150)) s!"wrong result: {repr expected}"
+    let value ← direct.call args
+    assertEqual value expected s!"wrong result: {repr value}"
+
+  /-- Functions in the binding manifest use the generated shim. -/
+  testcase testGeneratedBinding := do
+    let libm ← Library.mk "libm.so.6" .RTLD_NOW #[]
+    let pow ← ForeignFunction.bind libm "pow" .double #[.double, .double]
+    assertTrue pow.isGenerated "pow is not generated"
+    let value ← pow.call #[.double 1.5, .double 2.0]
+    assertEqual value (.double 2.25) s!"wrong result: {repr value}"
+
+    -- Other signatures fall back to the generic call.
+    let powf ← ForeignFunction.bind libm "powf" .float #[.float, .float]
+    assertTrue (!powf.isGenerated) "powf is generated"
+    let value ← powf.call #[.float 1.5, .float 2.0]
+    assertEqual value (.float 2.25) s!"wrong result: {repr value}"
+
+  /-- Blocking calls run on the call pool. -/
+  testcase testCallAsync requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "#include <unistd.h>\n" ++
+                       "int32_t slow(int32_t x) { usleep(20000); return 2 * x; }"
+    let slow ← lib["slow"]
+    let before ← Async.stats
+    let tasks ← (List.range 8).mapM fun i => slow.callAsync .int32 #[.int32 i] #[]
+    for (i, task) in (List.range 8).zip tasks do
+      match ← IO.wait task with
+      | .ok value => assertEqual value (.int32 (2 * i)) s!"wrong result: {repr value}"
+      | .error e => throw e
+    let stats ← Async.stats
+    assertTrue (stats.submitted ≥ before.submitted + 8) s!"calls not counted: {repr stats}"
+
+  /-- Apply a function to every element of a buffer. -/
+  testcase testMapCall requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "float half(int16_t x) { return x / 2.0f; }" ++
+                       "int16_t src[5] = {2, 4, -6, 8, 10}; float dst[5];"
+    let dst ← lib["dst"]
+    (← lib["half"]).mapCall (← lib["src"]) dst 5 .int16 .float
+    for (i, expected) in [(0, 1.0), (1, 2.0), (2, -3.0), (3, 4.0), (4, 5.0)] do
+      let value ← (dst + i * CType.float.size).read .float
+      assertEqual value (.float expected) s!"wrong result: {repr value}"
+
+  /-- Pass buffers to a function that modifies them in place. -/
+  testcase testCallWithBuffers requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "size_t scale(uint8_t *b, double *f, size_t n, const char *s) {" ++
+      "  for (size_t i = 0; i < n; i++) { b[i] *= 2; f[i] *= 2; }" ++
+      "  size_t len = 0; while (s[len]) len++; return len; }"
+    let bytes : ByteArray := ⟨#[1, 2, 3]⟩
+    let floats : FloatArray := ⟨#[0.5, 1.5, 2.5]⟩
+    let args := #[.bytes bytes, .floats floats, .value (.size_t 3), .string "hello"]
+    let result ← (← lib["scale"]).callWith .size_t args
+    assertEqual result.value (.size_t 5)
+    match result.args with
+    | #[.bytes b, .floats f, _, _] =>
+      assertEqual b.toList [2, 4, 6]
+      assertEqual f.data.toList [1.0, 3.0, 5.0]
+    | _ => assertTrue false "wrong arguments"
+    -- The original arrays are still referenced, so they were copied.
+    assertEqual bytes.toList [1, 2, 3]
+
+  /-- Arguments have to match the prepared signature. -/
+  testcase testForeignFunctionTypeMismatch requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int foo(int a) { return a; }"
+    let foo ← ForeignFunction.mk (← lib["foo"]) .int #[.int] #[]
+    try
+      discard <| foo.call #[.short 8]
+    catch e =>
+      assertEqual e.toString "argument type mismatch"
+      return
+    assertTrue false "foo.call did not fail"
+
   /-- Create a closure and call it as a pointer. -/
   testcase testCallClosure := do
     let callback : Callback := fun args => do
@@ -97,4 +221,82 @@ namespace Tests.Functions
     finally
       discard <| closures.mapM (fun c => c.delete)
 
+  /-- Closures that are deleted are reused. -/
+  testcase testClosurePool := do
+    let callback : Callback := fun args => return .int64 (args[0]!.int! + 1)
+    for i in [0:64] do
+      let closure ← Closure.mk .int64 #[.int64] callback
+      let result ← closure.pointer.call .int64 #[.int64 i] #[]
+      assertEqual result (.int64 (i + 1)) s!"wrong return value: {repr result}"
+      closure.delete
+
+    let before ← Closure.poolStats
+    for _ in [0:64] do
+      let closure ← Closure.mk .int64 #[.int64] callback
+      closure.delete
+    let after ← Closure.poolStats
+    assertEqual after.allocated before.allocated s!"closures not reused: {repr after}"
+
+  /-- Small integers returned by closures are widened correctly. -/
+  testcase testCallClosureSmallReturn requires (libgen : SharedLibrary) := do
+    let lib ← libgen "int32_t apply(int8_t (*f)(int8_t)) { return f(3) * 10; }"
+    let callback : Callback := fun args => return .int8 (args[0]!.int! - 8)
+    let closure ← Closure.mk .int8 #[.int8] callback
+    try
+      let result ← (← lib["apply"]).call .int32 #[.pointer closure.pointer] #[]
+      assertEqual result (.int32 (-50)) s!"wrong return value: {repr result}"
+    finally
+      closure.delete
+
+  /-- Sort an array with a typed comparator. -/
+  testcase testClosureComparator requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int32_t values[5] = {5, -3, 9, 1, 7};" ++
+      "void sort(int (*cmp)(const void *, const void *))" ++
+      "{ qsort(values, 5, sizeof(int32_t), cmp); }"
+    let compare (a b : USize) : IO Int := do
+      let va ← (Pointer.mk a).read .int32
+      let vb ← (Pointer.mk b).read .int32
+      return va.int! - vb.int!
+
+    let closure ← Closure.mkComparator compare
+    try
+      discard <| (← lib["sort"]).call .void #[.pointer closure.pointer] #[]
+      let values ← lib["values"]
+      let expected : List (Nat × Int) := [(0, -3), (1, 1), (2, 5), (3, 7), (4, 9)]
+      for (i, v) in expected do
+        let value ← (values + i * CType.int32.size).read .int32
+        assertEqual value (.int32 v) s!"wrong value: {repr value}"
+    finally
+      closure.delete
+
+  /-- Call a typed closure with two doubles. -/
+  testcase testClosureDoubleBinary := do
+    let closure ← Closure.mkDoubleBinary fun a b => return a * b + 1.0
+    try
+      let result ← closure.pointer.call .double #[.double 1.5, .double 2.0] #[]
+      assertEqual result (.double 4.0) s!"wrong return value: {repr result}"
+    finally
+      closure.delete
+
+  /-- Call a closure from threads that are not known to Lean. -/
+  testcase testCallClosureThreads requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "#include <pthread.h>\n" ++
+      "typedef int64_t (*fn_t)(int64_t);" ++
+      "struct job { fn_t f; int64_t sum; };" ++
+      "static void *worker(void *p) { struct job *j = p;" ++
+      "  for (int64_t i = 0; i < 1000; i++) j->sum += j->f(i); return NULL; }" ++
+      "int64_t run(fn_t f) { pthread_t t[4]; struct job jobs[4]; int64_t sum = 0;" ++
+      "  for (int i = 0; i < 4; i++) { jobs[i].f = f; jobs[i].sum = 0;" ++
+      "    pthread_create(&t[i], NULL, worker, &jobs[i]); }" ++
+      "  for (int i = 0; i < 4; i++) { pthread_join(t[i], NULL); sum += jobs[i].sum; }" ++
+      "  return sum; }"
+
+    let callback : Callback := fun args => return .int64 (2 * args[0]!.int!)
+    let closure ← Closure.mk .int64 #[.int64] callback
+    try
+      let result ← (← lib["run"]).call .int64 #[.pointer closure.pointer] #[]
+      assertEqual result (.int64 3996000) s!"wrong return value: {repr result}"
+    finally
+      closure.delete
+
 end Tests.Functions
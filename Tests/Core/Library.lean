@@ -0,0 +1,103 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import LTest
+import CTypes
+import Tests.Core.Fixtures
+open LTest
+open CTypes.Core
+
+namespace Tests.Library
+
+  /-- Look up several symbols and report the missing ones. -/
+  testcase testSymbols requires (libgen : SharedLibrary) := do
+    let lib ← libgen "int32_t a = 1; int32_t b = 2;"
+    let symbols ← lib.symbols #["a", "missing", "b"]
+    assertEqual symbols.size 3 "wrong number of symbols"
+    assertTrue symbols[1]!.isNone "missing symbol was found"
+    match symbols[0]!, symbols[2]! with
+    | some a, some b =>
+      assertEqual (← a.read .int32) (.int32 1) "wrong value of a"
+      assertEqual (← b.read .int32) (.int32 2) "wrong value of b"
+      -- Cached symbols have the same address.
+      assertEqual (← lib["a"]).address a.address "wrong address of a"
+    | _, _ => assertTrue false "symbol not found"
+
+  /-- Libraries share handles, and symbols keep their library loaded. -/
+  testcase testSharedHandle := do
+    let p ← do
+      let libm ← Library.mk "libm.so.6" .RTLD_NOW #[]
+      let again ← Library.mk "libm.so.6" .RTLD_NOW #[]
+      assertEqual (← libm["sqrt"]).address (← again["sqrt"]).address "wrong address"
+      -- Closing one library does not unload the other one.
+      again.close
+      libm["sqrt"]
+    let value ← p.call .double #[.double 16.0] #[]
+    assertEqual value (.double 4.0) s!"wrong result: {repr value}"
+
+  /-- Lazy symbols are looked up when they are used. -/
+  testcase testLazySymbol requires (libgen : SharedLibrary) := do
+    let lib ← libgen "int32_t a = 5;"
+    let a ← lib.lazySymbol "a"
+    assertTrue (!(← a.isResolved)) "symbol was resolved early"
+    assertEqual (← a.read .int32) (.int32 5) "wrong value of a"
+    assertTrue (← a.isResolved) "symbol was not resolved"
+    assertEqual (← a.resolve) (← lib["a"]).address "wrong address of a"
+
+    -- Missing symbols only fail when they are used.
+    let missing ← lib.lazySymbol "missing"
+    try
+      discard <| missing.resolve
+      assertTrue false "missing symbol was resolved"
+    catch e =>
+      assertTrue (e.toString.endsWith "undefined symbol: missing") e.toString
+    try
+      discard <| missing.read .int32
+    catch e =>
+      assertTrue (e.toString.endsWith "undefined symbol: missing") e.toString
+      return
+    assertTrue false "missing symbol was read"
+
+  /-- Offsets of lazy symbols are looked up when they are used. -/
+  testcase testLazySymbolOffset requires (libgen : SharedLibrary) := do
+    let lib ← libgen "int32_t v[2] = {1, 2};"
+    let v ← lib.lazySymbol "v"
+    let q := v + 4
+    assertTrue (!(← q.isResolved)) "offset was resolved early"
+    assertEqual (← q.read .int32) (.int32 2) "wrong value of v[1]"
+    assertTrue (!(← v.isResolved)) "symbol was resolved by its offset"
+
+    let missing ← lib.lazySymbol "missing"
+    try
+      discard <| (missing + 8).read .int32
+    catch e =>
+      assertTrue (e.toString.endsWith "undefined symbol: missing") e.toString
+      return
+    assertTrue false "offset of a missing symbol was read"
+
+  /-- Query the exported symbols. -/
+  testcase testExports requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int32_t sym_a = 1; int sym_b(void) { return 2; }" ++
+      "static int sym_hidden = 3; int other_c(void) { return sym_hidden; }"
+    let exports ← lib.exports
+    assertTrue (exports.contains "sym_a" && exports.contains "other_c") "missing exports"
+    assertTrue (!exports.contains "sym_hidden") "static symbol is exported"
+    assertEqual (← lib.exportsWithPrefix "sym_") #["sym_a", "sym_b"] "wrong prefix query"
+    assertEqual (← lib.exportsMatching "*_[bc]") #["other_c", "sym_b"] "wrong glob query"
+    let found ← lib.hasExports #["sym_b", "missing", "sym_a"]
+    assertEqual found #[true, false, true] "wrong existence check"
+
+end Tests.Library
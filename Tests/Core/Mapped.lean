@@ -0,0 +1,56 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import LTest
+import CTypes
+import Tests.Core.Fixtures
+open LTest
+open CTypes.Core
+
+namespace Tests.Mapped
+
+  /-- Map a part of a file and read it. -/
+  testcase testMapRange requires (dir : TemporaryDirectory) := do
+    let path := dir / "data"
+    IO.FS.writeBinFile path ⟨#[0, 1, 2, 3, 4, 5, 6, 7]⟩
+    let region ← MappedRegion.mkRange path.toString .readOnly 3 4
+    for advice in [.normal, .sequential, .random, .willNeed, .dontNeed] do
+      region.advise advice
+    -- Not every kernel supports huge pages for files.
+    try region.advise .hugePage catch _ => pure ()
+    assertEqual region.size 4 "wrong size"
+    assertEqual (← region.pointer.readBytes 4).toList [3, 4, 5, 6]
+
+  /-- Writes to a shared region are written back to the file. -/
+  testcase testMapShared requires (dir : TemporaryDirectory) := do
+    let path := dir / "data"
+    IO.FS.writeBinFile path ⟨#[0, 0, 0, 0]⟩
+    let region ← MappedRegion.mk path.toString .shared
+    region.pointer.write (.uint32 0x04030201)
+    region.sync
+    assertEqual (← IO.FS.readBinFile path).toList [1, 2, 3, 4]
+
+    -- Private regions don't change the file.
+    let copy ← MappedRegion.mk path.toString .copyOnWrite
+    copy.pointer.write (.uint32 0)
+    assertEqual (← copy.pointer.readBytes 4).toList [0, 0, 0, 0]
+    assertEqual (← IO.FS.readBinFile path).toList [1, 2, 3, 4]
+
+    -- Dropping the private pages restores the contents of the file.
+    copy.advise .dontNeed
+    assertEqual (← copy.pointer.readBytes 4).toList [1, 2, 3, 4]
+
+end Tests.Mapped
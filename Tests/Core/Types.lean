@@ -41,6 +41,15 @@ namespace Tests.Types
       assertEqual ct.size size s!"size: {repr ct}: {ct.size} != {size}"
       assertEqual ct.offsets offsets s!"offsets: {repr ct}: {ct.offsets} != {offsets}"
 
+  /-- Structurally equal types share a descriptor, also when they are nested. -/
+  testcase testTypesNested := do
+    let A := CType.struct #[.uint8, .uint64]
+    let B := CType.struct #[A, .uint8, A]
+    assertEqual A.size 16 s!"size: {A.size} != 16"
+    assertEqual B.size 48 s!"size: {B.size} != 48"
+    assertEqual B.offsets #[0, 16, 32] s!"offsets: {B.offsets} != #[0, 16, 32]"
+    assertEqual (CType.struct #[A, .uint8, A]).offsets B.offsets
+
   testcase testPointerMax := do
     let p := Pointer.mk 0xFFFFFFFFFFFFFFFF
     assertEqual s!"{p.address}" "18446744073709551615" s!"wrong address: {p.address}"
@@ -179,4 +188,78 @@ namespace Tests.Types
     let w ← pv.read $ .struct #[A, A]
     assertEqual v w
 
+  /-- Read and write an array of structs. -/
+  testcase testPointerArray requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "typedef struct { uint8_t a; int32_t b; } A;" ++
+                       "A v[3] = {{1, -1}, {2, -2}, {3, -3}};"
+    let A := CType.struct #[.uint8, .int32]
+    let pv ← lib["v"]
+    let values ← pv.readArray A 3
+    assertEqual values #[
+      .struct #[.uint8 1, .int32 (-1)],
+      .struct #[.uint8 2, .int32 (-2)],
+      .struct #[.uint8 3, .int32 (-3)]
+    ]
+
+    -- Write only the second field of every element.
+    let q := pv + 4
+    q.writeArray .int32 #[.int32 10, .int32 20, .int32 30] A.size
+    let fields ← q.readArray .int32 3 A.size
+    assertEqual fields #[.int32 10, .int32 20, .int32 30]
+    assertEqual (← pv.readArray A 3) #[
+      .struct #[.uint8 1, .int32 10],
+      .struct #[.uint8 2, .int32 20],
+      .struct #[.uint8 3, .int32 30]
+    ]
+
+  /-- Copy bytes in both directions. -/
+  testcase testPointerBytes requires (libgen : SharedLibrary) := do
+    let lib ← libgen "uint8_t v[5] = {1, 2, 3, 4, 5};"
+    let pv ← lib["v"]
+    assertEqual (← pv.readBytes 5).toList [1, 2, 3, 4, 5]
+    (pv + 1).writeBytes ⟨#[20, 30]⟩
+    assertEqual (← pv.readBytes 5).toList [1, 20, 30, 4, 5]
+
+  /-- Convert numbers to and from a FloatArray. -/
+  testcase testPointerFloats requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "int16_t s[11] = {-3, -2, -1, 0, 1, 2, 3, 4, 5, 6, 7};" ++
+                       "float f[6] = {0.5, 1.5, 2.5, 3.5, 4.5, 5.5};" ++
+                       "uint8_t u[3];"
+    let s ← (← lib["s"]).readFloats .int16 11
+    assertEqual s.data.toList [-3, -2, -1, 0, 1, 2, 3, 4, 5, 6, 7]
+    let f ← (← lib["f"]).readFloats .float 6
+    assertEqual f.data.toList [0.5, 1.5, 2.5, 3.5, 4.5, 5.5]
+
+    -- Integers are saturated.
+    let pu ← lib["u"]
+    pu.writeFloats .uint8 ⟨#[-1.0, 7.9, 300.0]⟩
+    assertEqual (← pu.readBytes 3).toList [0, 7, 255]
+
+  /-- Read and write single fields of nested structs. -/
+  testcase testPointerField requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "typedef struct { uint8_t a; uint16_t b; uint32_t c; uint64_t d; } A;" ++
+                       "typedef struct { A a; A b; } B;" ++
+                       "B v = {{0, 1, 2, 3}, {4, 5, 6, 7}};"
+    let A := CType.struct #[.uint8, .uint16, .uint32, .uint64]
+    let B := CType.struct #[A, A]
+    let path ← FieldPath.mk B #[1, 2]
+    assertEqual path.offset (A.size + 4) "wrong offset"
+
+    let pv ← lib["v"]
+    assertEqual (← pv.readField path) (.uint32 6)
+    pv.writeField path (.uint32 60)
+    assertEqual (← pv.readField path) (.uint32 60)
+    assertEqual (← pv.read B) (.struct #[
+      .struct #[.uint8 0, .uint16 1, .uint32 2, .uint64 3],
+      .struct #[.uint8 4, .uint16 5, .uint32 60, .uint64 7]
+    ])
+
+    -- Paths are checked when they are created.
+    try
+      discard <| FieldPath.mk B #[1, 4]
+    catch e =>
+      assertEqual e.toString "field index out of range"
+      return
+    assertTrue false "invalid path was created"
+
 end Tests.Types
@@ -34,4 +34,60 @@ namespace Tests.Utils
     finally
       free pointer
 
+  /-- Allocate buffers that are freed automatically. -/
+  testcase testBuffer := do
+    let type : CType := .struct #[.int, .int]
+    for _ in [0:4] do
+      let buffer ← Buffer.mk type.size
+      assertEqual buffer.size type.size "wrong size"
+      let zero ← buffer.pointer.read type
+      assertEqual zero (.struct #[.int 0, .int 0]) s!"not zeroed: {repr zero}"
+      buffer.pointer.write (.struct #[.int 100, .int 200])
+
+    -- Large buffers are not pooled.
+    let large ← Buffer.mk 100000 (zero := false)
+    let p := large.pointer + 99996
+    p.write (.int32 7)
+    assertEqual (← p.read .int32) (.int32 7)
+    assertEqual large.size 100000
+
+  /-- Build a linked list in an arena. -/
+  testcase testArena := do
+    let arena ← Arena.mk (chunkSize := 256)
+    let node : CType := .struct #[.int32, .pointer]
+    let mut next := Pointer.null
+    for i in [0:100] do
+      next ← arena.allocValue (.struct #[.int32 i, .pointer next])
+
+    -- Walk the list from the last node.
+    let mut sum : Int := 0
+    while next != Pointer.null do
+      let value ← next.read node
+      match value with
+      | .struct #[.int32 v, .pointer p] =>
+        sum := sum + v
+        next := p
+      | _ =>
+        assertTrue false s!"wrong node: {repr value}"
+        return
+    assertEqual sum 4950 "wrong sum"
+    assertTrue ((← arena.used) >= 100 * node.size) "wrong number of bytes used"
+
+    arena.reset
+    assertEqual (← arena.used) 0 "arena not empty after reset"
+    let p ← arena.alloc 8 (align := 8)
+    assertEqual (p.address % 8) 0 "wrong alignment"
+
+  /-- Frames that don't fit into a chunk of the arena are counted. -/
+  testcase testFrameArenaStats requires (libgen : SharedLibrary) := do
+    let lib ← libgen $ "typedef struct { uint64_t a[9000]; } S;" ++
+                       "uint64_t sum(S s) { return s.a[0] + s.a[8999]; }"
+    let value := CValue.struct <| Array.mkArray 9000 (.uint64 21)
+    let result ← (← lib["sum"]).call .uint64 #[value] #[]
+    assertEqual result (.uint64 42) s!"wrong result: {repr result}"
+
+    let stats ← frameArenaStats
+    assertTrue (stats.highWater ≥ 72000) s!"high water mark too low: {repr stats}"
+    assertTrue (stats.overflows > 0) s!"no overflow: {repr stats}"
+
 end Tests.Utils
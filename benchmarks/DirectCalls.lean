@@ -0,0 +1,58 @@
+--
+-- Copyright 2023 Alexander Fasching
+--
+-- Licensed under the Apache License, Version 2.0 (the "License");
+-- you may not use this file except in compliance with the License.
+-- You may obtain a copy of the License at
+--
+-- http://www.apache.org/licenses/LICENSE-2.0
+--
+-- Unless required by applicable law or agreed to in writing, software
+-- distributed under the License is distributed on an "AS IS" BASIS,
+-- WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+-- See the License for the specific language governing permissions and
+-- limitations under the License.
+--
+
+import CTypes
+open CTypes.Core
+
+/-- Number of calls per measurement. -/
+def iterations : Nat := 1000000
+
+/-- Call a function repeatedly and return the average time per call in nanoseconds. -/
+def measure (f : ForeignFunction) (args : Array CValue) : IO Float := do
+  let start ← IO.monoNanosNow
+  for _ in [0:iterations] do
+    discard <| f.call args
+  let stop ← IO.monoNanosNow
+  return (stop - start).toFloat / iterations.toFloat
+
+/-- Compare a direct call with a call through libffi. -/
+def compare (name : String) (p : Pointer) (rtype : CType) (args : Array CValue) : IO Unit := do
+  let types := args.map CValue.type
+  let direct ← ForeignFunction.mk p rtype types #[]
+  let generic ← ForeignFunction.mkGeneric p rtype types #[]
+  if !direct.isDirect then
+    IO.println s!"{name}: no direct call on this platform"
+    return
+
+  let tg ← measure generic args
+  let td ← measure direct args
+  IO.println s!"{name}: libffi {tg} ns, direct {td} ns, speedup {tg / td}"
+
+def main (_ : List String) : IO UInt32 := do
+  let libm ← Library.mk "libm.so.6" .RTLD_NOW #[]
+  let libc ← Library.mk "libc.so.6" .RTLD_NOW #[]
+
+  -- An empty string for `strnlen`.
+  let buffer ← malloc 64
+
+  compare "double(double)" (← libm["sqrt"]) .double #[.double 2.0]
+  compare "double(double,double)" (← libm["pow"]) .double #[.double 1.5, .double 2.0]
+  compare "float(float)" (← libm["sqrtf"]) .float #[.float 2.0]
+  compare "int64(pointer,uint64)" (← libc["strnlen"]) .int64 #[.pointer buffer, .uint64 64]
+  compare "void(pointer)" (← libc["free"]) .void #[.pointer Pointer.null]
+
+  free buffer
+  return 0
@@ -63,26 +63,128 @@ def extraDepTrace (cfile : FilePath) : BuildM BuildTrace := do
   return traces.foldr .mix .nil
 
 
-/-- Create a target from a C++ file. -/
-def createTarget (pkg : Package) (cfile : FilePath) := do
-  let oFile := pkg.buildDir / cfile.withExtension "o"
-  let srcJob ← inputFile <| pkg.dir / cfile
+/--
+  Compile a C++ file.
+  The included files are traced with the dependencies of `depFile`.
+-/
+def compileTarget (pkg : Package) (cFile oFile : FilePath) (srcJob : BuildJob FilePath)
+    (depFile : FilePath) := do
   let weakArgs := #[
-    "-I", (← getLeanIncludeDir).toString
+    "-I", (← getLeanIncludeDir).toString,
+    "-I", (pkg.dir / "src").toString
   ]
   let traceArgs := #[
     "-fPIC",
     "-Wall",
     "-std=c++20"
   ] ++ debugFlags ++ profileFlags
-  let cFile := pkg.dir / cfile
   let cxx := (← IO.getEnv "LEAN_CC").getD "clang++"
-  buildO cFile.toString oFile srcJob weakArgs traceArgs cxx (extraDepTrace cFile)
+  buildO cFile.toString oFile srcJob weakArgs traceArgs cxx (extraDepTrace depFile)
+
+/-- Create a target from a C++ file. -/
+def createTarget (pkg : Package) (cfile : FilePath) := do
+  let oFile := pkg.buildDir / cfile.withExtension "o"
+  let srcJob ← inputFile <| pkg.dir / cfile
+  compileTarget pkg (pkg.dir / cfile) oFile srcJob (pkg.dir / cfile)
+
+/-- Tags of the types that can be used in the binding manifest, including aliases. -/
+def bindingTags : List (String × String) := [
+  ("void", "VOID"),
+  ("int8", "INT8"), ("int16", "INT16"), ("int32", "INT32"), ("int64", "INT64"),
+  ("uint8", "UINT8"), ("uint16", "UINT16"), ("uint32", "UINT32"), ("uint64", "UINT64"),
+  ("float", "FLOAT"), ("double", "DOUBLE"), ("longdouble", "LONGDOUBLE"),
+  ("complex_float", "COMPLEX_FLOAT"), ("complex_double", "COMPLEX_DOUBLE"),
+  ("complex_longdouble", "COMPLEX_LONGDOUBLE"),
+  ("pointer", "POINTER"),
+  -- Aliases from `CType`.
+  ("char", "INT8"), ("short", "INT16"), ("int", "INT32"), ("long", "INT64"),
+  ("longlong", "INT64"), ("ssize_t", "INT64"), ("time_t", "INT64"),
+  ("uchar", "UINT8"), ("ushort", "UINT16"), ("uint", "UINT32"), ("ulong", "UINT64"),
+  ("ulonglong", "UINT64"), ("size_t", "UINT64")
+]
+
+/-- Parse a line `rtype name(type, ...)` of the binding manifest. -/
+def parseBinding (line : String) : Except String (String × String × List String) := do
+  let tag (name : String) : Except String String :=
+    match bindingTags.lookup name.trim with
+    | some t => pure t
+    | none => throw s!"unknown type '{name.trim}' in binding '{line}'"
+  let argTag (name : String) : Except String String := do
+    let t ← tag name
+    if t == "VOID" then throw s!"void argument in binding '{line}'"
+    return t
+
+  match line.splitOn "(" with
+  | [decl, args] =>
+    let args := args.trim
+    unless args.endsWith ")" do throw s!"missing ')' in binding '{line}'"
+    let args := (args.dropRight 1).trim
+    let args := if args.isEmpty || args == "void" then [] else args.splitOn ","
+    match decl.split Char.isWhitespace |>.filter (· != "") with
+    | [rtype, name] => return (name, ← tag rtype, ← args.mapM argTag)
+    | _ => throw s!"invalid declaration in binding '{line}'"
+  | _ => throw s!"invalid binding '{line}'"
+
+/--
+  Generate the C++ source of the bindings in a manifest.
+  Every binding instantiates the shim template `binding_call` in `src/bindings.hpp`.
+-/
+def generateBindings (manifest : String) : Except String String := do
+  let lines := manifest.splitOn "\n" |>.map String.trim
+    |>.filter fun l => !l.isEmpty && !l.startsWith "#"
+  let bindings ← lines.mapM parseBinding
+
+  let mut argArrays := ""
+  let mut entries := ""
+  for (i, name, rtype, args) in bindings.enum do
+    let argsName := if args.isEmpty then "nullptr" else s!"args_{i}"
+    if !args.isEmpty then
+      argArrays := argArrays ++ s!"static const ObjectTag args_{i}[] = \{{", ".intercalate args}};\n"
+    let tags := ", ".intercalate (rtype :: args)
+    entries := entries ++
+      s!"        \{\"{name}\", {rtype}, {argsName}, {args.length}, &binding_call<{tags}>},\n"
+
+  let body := if bindings.isEmpty then "    return {};\n" else
+    "    static const Binding bindings[] = {\n" ++ entries ++ "    };\n    return bindings;\n"
+  return "// Generated from the binding manifest. Do not edit.\n\n" ++
+    "#include \"bindings.hpp\"\n\n" ++ argArrays ++
+    "\nstd::span<const Binding> generated_bindings() {\n" ++ body ++ "}\n"
+
+/--
+  Generate the bindings from the manifest and compile them.
+  The manifest is `bindings.txt`, unless another one is set with `-K bindings=<path>`.
+-/
+target bindings_generated.o pkg : FilePath := do
+  let manifest := pkg.dir / ((get_config? bindings).getD "bindings.txt")
+  let cFile := pkg.buildDir / "src" / "bindings_generated.cpp"
+  let oFile := pkg.buildDir / "src" / "bindings_generated.o"
+  let manifestJob ← inputFile manifest
+  let srcJob ← buildFileAfterDep cFile manifestJob fun manifest => do
+    match generateBindings (← IO.FS.readFile manifest) with
+    | .ok source =>
+      createParentDirs cFile
+      IO.FS.writeFile cFile source
+    | .error msg => error msg
+  -- The generated file has the same includes as `bindings.cpp`.
+  compileTarget pkg cFile oFile srcJob (pkg.dir / "src" / "bindings.cpp")
 
+target arena.o pkg : FilePath := createTarget pkg $ "src" / "arena.cpp"
+target async.o pkg : FilePath := createTarget pkg $ "src" / "async.cpp"
+target bindings.o pkg : FilePath := createTarget pkg $ "src" / "bindings.cpp"
+target buffer.o pkg : FilePath := createTarget pkg $ "src" / "buffer.cpp"
 target callback.o pkg : FilePath := createTarget pkg $ "src" / "callback.cpp"
 target closure.o pkg : FilePath := createTarget pkg $ "src" / "closure.cpp"
+target convert.o pkg : FilePath := createTarget pkg $ "src" / "convert.cpp"
+target direct.o pkg : FilePath := createTarget pkg $ "src" / "direct.cpp"
+target field.o pkg : FilePath := createTarget pkg $ "src" / "field.cpp"
+target frame.o pkg : FilePath := createTarget pkg $ "src" / "frame.cpp"
+target function.o pkg : FilePath := createTarget pkg $ "src" / "function.cpp"
 target library.o pkg : FilePath := createTarget pkg $ "src" / "library.cpp"
+target mapped.o pkg : FilePath := createTarget pkg $ "src" / "mapped.cpp"
 target pointer.o pkg : FilePath := createTarget pkg $ "src" / "pointer.cpp"
+target signature.o pkg : FilePath := createTarget pkg $ "src" / "signature.cpp"
+target symbol_index.o pkg : FilePath := createTarget pkg $ "src" / "symbol_index.cpp"
+target thread.o pkg : FilePath := createTarget pkg $ "src" / "thread.cpp"
 target types.o pkg : FilePath := createTarget pkg $ "src" / "types.cpp"
 target utils.o pkg : FilePath := createTarget pkg $ "src" / "utils.cpp"
 
@@ -93,10 +195,24 @@ target types_common.o pkg : FilePath := createTarget pkg $ "src" / "types" / "co
 extern_lib libctypes pkg := do
   let name := nameToStaticLib "ctypes"
   let targets := #[
+    (← fetch <| pkg.target ``arena.o),
+    (← fetch <| pkg.target ``async.o),
+    (← fetch <| pkg.target ``bindings.o),
+    (← fetch <| pkg.target ``bindings_generated.o),
+    (← fetch <| pkg.target ``buffer.o),
     (← fetch <| pkg.target ``callback.o),
     (← fetch <| pkg.target ``closure.o),
+    (← fetch <| pkg.target ``convert.o),
+    (← fetch <| pkg.target ``direct.o),
+    (← fetch <| pkg.target ``field.o),
+    (← fetch <| pkg.target ``frame.o),
+    (← fetch <| pkg.target ``function.o),
     (← fetch <| pkg.target ``library.o),
+    (← fetch <| pkg.target ``mapped.o),
     (← fetch <| pkg.target ``pointer.o),
+    (← fetch <| pkg.target ``signature.o),
+    (← fetch <| pkg.target ``symbol_index.o),
+    (← fetch <| pkg.target ``thread.o),
     (← fetch <| pkg.target ``types.o),
     (← fetch <| pkg.target ``utils.o),
     (← fetch <| pkg.target ``types_ctype.o),
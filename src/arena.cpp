@@ -0,0 +1,159 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arena.hpp"
+#include "pointer.hpp"
+#include "types.hpp"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+/** Allocate a contiguous block. */
+uint8_t *BumpAllocator::alloc(size_t size, size_t alignment) {
+    alignment = std::max<size_t>(alignment, 1);
+
+    // Try the current chunk and then the ones left over from earlier spikes.
+    while (m_current < m_chunks.size()) {
+        auto &chunk = m_chunks[m_current];
+        uintptr_t start = (uintptr_t)chunk.data + m_offset;
+        size_t padding = (alignment - start % alignment) % alignment;
+        if (m_offset + padding + size <= chunk.size) {
+            m_offset += padding + size;
+            return chunk.data + m_offset - size;
+        }
+
+        m_overflows++;
+        chunk.used = m_offset;
+        if (m_current + 1 == m_chunks.size())
+            break;
+        m_current++;
+        m_offset = 0;
+    }
+
+    // Append a new chunk that is large enough for the block.
+    size_t chunk_size = std::max(m_chunk_size, size + alignment);
+    uint8_t *data = new uint8_t[chunk_size];
+    m_chunks.push_back({data, chunk_size, 0});
+    m_current = m_chunks.size() - 1;
+
+    size_t padding = (alignment - (uintptr_t)data % alignment) % alignment;
+    m_offset = padding + size;
+    return data + padding;
+}
+
+/** Release everything and free all but the first `keep` chunks. */
+void BumpAllocator::trim(size_t keep) {
+    for (size_t i = keep; i < m_chunks.size(); i++)
+        delete[] m_chunks[i].data;
+    m_chunks.resize(std::min(keep, m_chunks.size()));
+    m_current = 0;
+    m_offset = 0;
+}
+
+/**
+ * Number of bytes allocated, including padding.
+ *
+ * Space left at the end of a chunk that was too small for the next block is not
+ * counted.
+ */
+size_t BumpAllocator::used() const {
+    size_t used = m_offset;
+    for (size_t i = 0; i < m_current && i < m_chunks.size(); i++)
+        used += m_chunks[i].used;
+    return used;
+}
+
+/** Number of bytes reserved in chunks. */
+size_t BumpAllocator::capacity() const {
+    size_t capacity = 0;
+    for (auto &chunk : m_chunks)
+        capacity += chunk.size;
+    return capacity;
+}
+
+/** Get the arena of the calling thread. */
+FrameArena &FrameArena::local() {
+    static thread_local FrameArena arena;
+    return arena;
+}
+
+/** Allocate a block. */
+uint8_t *Arena::alloc(size_t size, size_t alignment) {
+    if (!std::has_single_bit(alignment))
+        throw std::runtime_error("alignment is not a power of two");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocator.alloc(size, alignment);
+}
+
+/**
+ * Create an arena.
+ *
+ * All arguments are borrowed.
+ */
+extern "C" lean_obj_res Arena_mk(b_lean_obj_arg chunk_size_obj, lean_object *unused) {
+    size_t chunk_size = lean_usize_of_nat(chunk_size_obj);
+    return lean_io_result_mk_ok((new Arena(chunk_size))->box());
+}
+
+/**
+ * Allocate a block in the arena.
+ *
+ * The pointer keeps the arena alive.
+ */
+extern "C" lean_obj_res Arena_alloc(b_lean_obj_arg arena_obj, b_lean_obj_arg size_obj,
+                                    b_lean_obj_arg alignment_obj, lean_object *unused) {
+    try {
+        size_t size = lean_usize_of_nat(size_obj);
+        size_t alignment = lean_usize_of_nat(alignment_obj);
+        uint8_t *block = Arena::unbox(arena_obj)->alloc(size, alignment);
+        return lean_io_result_mk_ok((new Pointer(block, arena_obj))->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Write a value to a new block in the arena.
+ *
+ * The block has the size and the alignment of the type of the value.
+ */
+extern "C" lean_obj_res Arena_allocValue(b_lean_obj_arg arena_obj,
+                                         b_lean_obj_arg value_obj,
+                                         lean_object *unused) {
+    try {
+        auto type = CValue::type_of(value_obj);
+        auto arena = Arena::unbox(arena_obj);
+        uint8_t *block = arena->alloc(type->size(), type->alignment());
+        CValue::marshal(*type, value_obj, block);
+        return lean_io_result_mk_ok((new Pointer(block, arena_obj))->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Release all blocks of the arena. */
+extern "C" lean_obj_res Arena_reset(b_lean_obj_arg arena_obj, lean_object *unused) {
+    Arena::unbox(arena_obj)->reset();
+    return lean_io_result_mk_ok(lean_box(0));
+}
+
+/** Get the number of bytes allocated in the arena. */
+extern "C" lean_obj_res Arena_used(b_lean_obj_arg arena_obj, lean_object *unused) {
+    return lean_io_result_mk_ok(lean_usize_to_nat(Arena::unbox(arena_obj)->used()));
+}
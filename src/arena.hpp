@@ -0,0 +1,198 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "external_type.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <lean/lean.h>
+#include <mutex>
+#include <vector>
+
+/**
+ * Bump allocator that reserves memory in chunks.
+ *
+ * Single blocks can't be freed. Instead, the allocator is rewound to a mark and
+ * everything allocated after it is released at once. Chunks are kept for reuse
+ * until they are trimmed.
+ */
+class BumpAllocator {
+  public:
+    /** Position in the allocator. */
+    struct Mark {
+        size_t chunk;
+        size_t offset;
+    };
+
+    BumpAllocator(size_t chunk_size) : m_chunk_size(chunk_size) {}
+    ~BumpAllocator() { trim(0); }
+
+    BumpAllocator(const BumpAllocator &) = delete;
+    BumpAllocator &operator=(const BumpAllocator &) = delete;
+
+    /**
+     * Allocate a contiguous block.
+     *
+     * Blocks that don't fit into the remaining space get a new chunk, which is at
+     * least large enough for the block.
+     */
+    uint8_t *alloc(size_t size, size_t alignment);
+
+    /** Get the current position. */
+    Mark mark() const { return {m_current, m_offset}; }
+
+    /** Release everything allocated after the mark. */
+    void rewind(Mark mark) {
+        m_current = mark.chunk;
+        m_offset = mark.offset;
+    }
+
+    /** Release everything and free all but the first `keep` chunks. */
+    void trim(size_t keep);
+
+    /** Number of bytes allocated, including padding. */
+    size_t used() const;
+
+    /** Number of bytes reserved in chunks. */
+    size_t capacity() const;
+
+    /** Number of allocations that required a new chunk. */
+    size_t overflows() const { return m_overflows; }
+
+  private:
+    struct Chunk {
+        uint8_t *data;
+        size_t size;
+        // Offset at which the allocator left the chunk for the next one.
+        size_t used;
+    };
+
+    // Size of regular chunks.
+    size_t m_chunk_size;
+    // Chunks, the current one and the offset in it.
+    std::vector<Chunk> m_chunks;
+    size_t m_current = 0;
+    size_t m_offset = 0;
+    size_t m_overflows = 0;
+};
+
+/**
+ * Arena for buffers whose lifetime is a single call.
+ *
+ * Every thread has its own arena, so allocating from it requires neither a lock
+ * nor a call to malloc(). Memory is allocated inside a Scope and released when
+ * the scope ends. Scopes nest, e.g. when a callback is invoked during a call.
+ */
+class FrameArena {
+  public:
+    /** Releases the memory allocated in its lifetime. */
+    class Scope {
+      public:
+        Scope() : m_arena(local()), m_mark(m_arena.m_allocator.mark()) {
+            m_arena.m_depth++;
+        }
+        ~Scope() { m_arena.leave(m_mark); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+      private:
+        FrameArena &m_arena;
+        BumpAllocator::Mark m_mark;
+    };
+
+    /** Get the arena of the calling thread. */
+    static FrameArena &local();
+
+    /** Allocate a block. It is released at the end of the innermost scope. */
+    uint8_t *alloc(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        uint8_t *p = m_allocator.alloc(size, alignment);
+        m_high_water = std::max(m_high_water, m_allocator.used());
+        return p;
+    }
+
+    /** Allocate an uninitialized array. */
+    template <class T> T *alloc_array(size_t n) {
+        return (T *)alloc(n * sizeof(T), alignof(T));
+    }
+
+    /** Largest number of bytes in use at the same time. */
+    size_t high_water() const { return m_high_water; }
+
+    /** Number of allocations that did not fit into the current chunk. */
+    size_t overflows() const { return m_allocator.overflows(); }
+
+    /** Number of bytes currently reserved. */
+    size_t capacity() const { return m_allocator.capacity(); }
+
+  private:
+    // Regular chunk size. Larger frames get their own chunk.
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    // All chunks are freed when the outermost scope ends with more than this.
+    static constexpr size_t SHRINK_THRESHOLD = 4 * CHUNK_SIZE;
+
+    FrameArena() : m_allocator(CHUNK_SIZE) {}
+
+    /** Rewind to the start of a scope and shrink after spikes. */
+    void leave(BumpAllocator::Mark mark) {
+        m_allocator.rewind(mark);
+        if (--m_depth == 0 && m_allocator.capacity() > SHRINK_THRESHOLD)
+            m_allocator.trim(0);
+    }
+
+    BumpAllocator m_allocator;
+    size_t m_depth = 0;
+    size_t m_high_water = 0;
+};
+
+/**
+ * Arena for C memory whose lifetime is controlled from Lean.
+ *
+ * Blocks are never freed one by one. All of them are released at once by reset()
+ * or when the arena is finalized. The arena can be shared between threads.
+ */
+class Arena final : public ExternalType<Arena> {
+  public:
+    Arena(size_t chunk_size) : m_allocator(chunk_size) {}
+
+    /**
+     * Allocate a block.
+     *
+     * Raises an exception if the alignment is not a power of two.
+     */
+    uint8_t *alloc(size_t size, size_t alignment);
+
+    /** Release all blocks and keep the first chunk for reuse. */
+    void reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allocator.trim(1);
+    }
+
+    /** Number of bytes allocated, including padding. */
+    size_t used() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_allocator.used();
+    }
+
+    /** No children. */
+    const std::vector<lean_object *> children() { return {}; }
+
+  private:
+    std::mutex m_mutex;
+    BumpAllocator m_allocator;
+};
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "async.hpp"
+#include "frame.hpp"
+#include "pointer.hpp"
+#include "thread.hpp"
+#include "types.hpp"
+#include <algorithm>
+#include <lean/lean.h>
+#include <stdexcept>
+#include <thread>
+
+/** Resolve an `IO.Promise (Except IO.Error CValue)`. Implemented in Lean. */
+extern "C" lean_obj_res ctypes_async_resolve(lean_obj_arg promise, lean_obj_arg result,
+                                             lean_obj_arg world);
+
+/**
+ * Prepare a call of `fn`.
+ *
+ * This runs on the calling thread, so errors in the arguments are reported before
+ * the call is queued.
+ */
+AsyncCall::AsyncCall(b_lean_obj_arg fn_obj, const CType &rtype, b_lean_obj_arg args,
+                     b_lean_obj_arg vargs, b_lean_obj_arg promise)
+    : m_fn(Pointer::unbox(fn_obj)->pointer()), m_rtype(&rtype), m_promise(promise) {
+
+    size_t nfixed = lean_array_size(args);
+    size_t nargs = nfixed + lean_array_size(vargs);
+    auto arg = [&](size_t i) {
+        return i < nfixed ? lean_array_get_core(args, i)
+                          : lean_array_get_core(vargs, i - nfixed);
+    };
+
+    for (size_t i = 0; i < nargs; i++) {
+        m_types.push_back(CValue::type_of(arg(i)));
+        m_ffi_argtypes.push_back(m_types[i]->ffitype());
+    }
+
+    if (nargs == nfixed) {
+        ffi_status status = ffi_prep_cif(&m_cif, FFI_DEFAULT_ABI, nargs,
+                                         rtype.ffitype(), m_ffi_argtypes.data());
+        if (status != FFI_OK)
+            throw std::runtime_error("ffi_prep_cif() failed");
+    } else {
+        ffi_status status =
+            ffi_prep_cif_var(&m_cif, FFI_DEFAULT_ABI, nfixed, nargs, rtype.ffitype(),
+                             m_ffi_argtypes.data());
+        if (status != FFI_OK)
+            throw std::runtime_error("ffi_prep_cif_var() failed");
+    }
+
+    // The buffer of operator new is aligned for all scalar types.
+    size_t alignment;
+    std::vector<size_t> offsets(nargs);
+    size_t size = CallFrame::layout(rtype, m_types.data(), nargs, offsets.data(),
+                                    alignment);
+    m_data.reset(new uint8_t[size]);
+    for (size_t i = 0; i < nargs; i++) {
+        m_argvals.push_back(m_data.get() + offsets[i]);
+        CValue::marshal(*m_types[i], arg(i), m_data.get() + offsets[i]);
+    }
+
+    // The objects are shared with the worker thread and released there.
+    m_objects = {m_promise, fn_obj, args, vargs};
+    for (auto o : m_objects) {
+        lean_mark_mt(o);
+        lean_inc(o);
+    }
+}
+
+/** Call the function and resolve the promise with the result. */
+void AsyncCall::run() {
+    ffi_call(&m_cif, (void (*)())m_fn, m_data.get(), m_argvals.data());
+
+    // Except.ok
+    lean_object *result = lean_alloc_ctor(1, 1, 0);
+    lean_ctor_set(result, 0, CValue::unmarshal(*m_rtype, m_data.get()));
+    resolve(result);
+}
+
+/** Resolve the promise with an `Except IO.Error CValue` object. */
+void AsyncCall::resolve(lean_obj_arg result) {
+    lean_mark_mt(result);
+    lean_inc(m_promise);
+    lean_dec(ctypes_async_resolve(m_promise, result, lean_io_mk_world()));
+}
+
+/** Get the pool of the process. */
+CallPool &CallPool::global() {
+    // Never destroyed, because detached workers might still use it at exit.
+    static CallPool *pool = new CallPool();
+    return *pool;
+}
+
+CallPool::CallPool() : m_running(0), m_stats{} {
+    m_stats.threads = 4;
+    m_stats.queue_depth = 256;
+}
+
+/** Set the number of threads and the maximum number of queued calls. */
+void CallPool::configure(size_t threads, size_t queue_depth) {
+    if (threads == 0 || queue_depth == 0)
+        throw std::runtime_error("invalid call pool configuration");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.threads = threads;
+    m_stats.queue_depth = queue_depth;
+    m_not_empty.notify_all();
+    m_not_full.notify_all();
+}
+
+/** Queue a call. */
+void CallPool::submit(std::unique_ptr<AsyncCall> call) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_running < m_stats.threads) {
+        std::thread(&CallPool::worker, this).detach();
+        m_running++;
+    }
+
+    m_not_full.wait(lock, [&] { return m_queue.size() < m_stats.queue_depth; });
+    m_queue.push_back({std::move(call), Clock::now()});
+    m_stats.submitted++;
+    m_not_empty.notify_one();
+}
+
+/** Get a snapshot of the statistics. */
+CallPoolStats CallPool::stats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    CallPoolStats stats = m_stats;
+    stats.queued = m_queue.size();
+    return stats;
+}
+
+/** Main loop of a worker thread. */
+void CallPool::worker() {
+    // Results are Lean objects, so the thread has to be known to the runtime.
+    LeanThread::ensure();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_not_empty.wait(lock, [&] {
+            return !m_queue.empty() || m_running > m_stats.threads;
+        });
+        if (m_running > m_stats.threads)
+            break;
+
+        Job job = std::move(m_queue.front());
+        m_queue.pop_front();
+        m_not_full.notify_one();
+        lock.unlock();
+
+        auto start = Clock::now();
+        job.call->run();
+        auto end = Clock::now();
+        job.call.reset();
+
+        lock.lock();
+        uint64_t queue_time = (start - job.submitted) / std::chrono::nanoseconds(1);
+        uint64_t exec_time = (end - start) / std::chrono::nanoseconds(1);
+        m_stats.completed++;
+        m_stats.queue_time += queue_time;
+        m_stats.exec_time += exec_time;
+        m_stats.max_queue_time = std::max(m_stats.max_queue_time, queue_time);
+        m_stats.max_exec_time = std::max(m_stats.max_exec_time, exec_time);
+    }
+
+    m_running--;
+}
+
+/**
+ * Queue a call of the pointer on the call pool.
+ *
+ * The promise is resolved with the result once the call is done.
+ */
+extern "C" lean_obj_res Pointer_callAsync(b_lean_obj_arg ptr, b_lean_obj_arg rtype,
+                                          b_lean_obj_arg args, b_lean_obj_arg vargs,
+                                          b_lean_obj_arg promise, lean_object *unused) {
+    try {
+        auto call = std::make_unique<AsyncCall>(ptr, *CType::unbox(rtype), args, vargs,
+                                                promise);
+        CallPool::global().submit(std::move(call));
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Set the number of threads and the queue depth of the call pool. */
+extern "C" lean_obj_res Async_configure(b_lean_obj_arg threads,
+                                        b_lean_obj_arg queue_depth,
+                                        lean_object *unused) {
+    try {
+        CallPool::global().configure(lean_usize_of_nat(threads),
+                                     lean_usize_of_nat(queue_depth));
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Get the statistics of the call pool. */
+extern "C" lean_obj_res Async_stats(lean_object *unused) {
+    auto stats = CallPool::global().stats();
+    lean_object *obj = lean_alloc_ctor(0, 9, 0);
+    lean_ctor_set(obj, 0, lean_usize_to_nat(stats.threads));
+    lean_ctor_set(obj, 1, lean_usize_to_nat(stats.queue_depth));
+    lean_ctor_set(obj, 2, lean_usize_to_nat(stats.queued));
+    lean_ctor_set(obj, 3, lean_usize_to_nat(stats.submitted));
+    lean_ctor_set(obj, 4, lean_usize_to_nat(stats.completed));
+    lean_ctor_set(obj, 5, lean_uint64_to_nat(stats.queue_time));
+    lean_ctor_set(obj, 6, lean_uint64_to_nat(stats.max_queue_time));
+    lean_ctor_set(obj, 7, lean_uint64_to_nat(stats.exec_time));
+    lean_ctor_set(obj, 8, lean_uint64_to_nat(stats.max_exec_time));
+    return lean_io_result_mk_ok(obj);
+}
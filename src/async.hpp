@@ -0,0 +1,134 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <ffi.h>
+#include <lean/lean.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * A foreign call that runs on the call pool.
+ *
+ * The arguments are marshalled and the CIF is prepared when the call is created, so
+ * the worker thread only has to call the function and create the result.
+ */
+class AsyncCall {
+  public:
+    /**
+     * Prepare a call of the pointer `fn_obj`.
+     *
+     * `promise` is an `IO.Promise (Except IO.Error CValue)` that is resolved with the
+     * result. The call keeps references to it, to the pointer and to the arguments,
+     * so the owners of pointer arguments stay alive until the call is done.
+     */
+    AsyncCall(b_lean_obj_arg fn_obj, const CType &rtype, b_lean_obj_arg args,
+              b_lean_obj_arg vargs, b_lean_obj_arg promise);
+
+    AsyncCall(const AsyncCall &) = delete;
+    AsyncCall &operator=(const AsyncCall &) = delete;
+
+    ~AsyncCall() {
+        for (auto o : m_objects)
+            lean_dec(o);
+    }
+
+    /** Call the function and resolve the promise with the result. */
+    void run();
+
+  private:
+    /** Resolve the promise with an `Except IO.Error CValue` object. */
+    void resolve(lean_obj_arg result);
+
+    uint8_t *m_fn;
+    const CType *m_rtype;
+    std::vector<const CType *> m_types;
+    std::vector<ffi_type *> m_ffi_argtypes;
+    ffi_cif m_cif;
+    // Frame with the same layout as CallFrame, but on the heap.
+    std::unique_ptr<uint8_t[]> m_data;
+    std::vector<void *> m_argvals;
+    lean_object *m_promise;
+    // Objects that are referenced until the call is destroyed.
+    std::vector<lean_object *> m_objects;
+};
+
+/** Statistics of the call pool. Times are in nanoseconds. */
+struct CallPoolStats {
+    size_t threads;
+    size_t queue_depth;
+    size_t queued;
+    size_t submitted;
+    size_t completed;
+    uint64_t queue_time;
+    uint64_t max_queue_time;
+    uint64_t exec_time;
+    uint64_t max_exec_time;
+};
+
+/**
+ * Bounded pool of native threads for blocking foreign calls.
+ *
+ * The threads are separate from the task workers of Lean and are started on demand.
+ * Submitting a call blocks while the queue is full.
+ */
+class CallPool {
+  public:
+    /** Get the pool of the process. */
+    static CallPool &global();
+
+    /**
+     * Set the number of threads and the maximum number of queued calls.
+     *
+     * Surplus threads exit once they are idle.
+     */
+    void configure(size_t threads, size_t queue_depth);
+
+    /** Queue a call. */
+    void submit(std::unique_ptr<AsyncCall> call);
+
+    /** Get a snapshot of the statistics. */
+    CallPoolStats stats();
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::unique_ptr<AsyncCall> call;
+        Clock::time_point submitted;
+    };
+
+    CallPool();
+
+    /** Main loop of a worker thread. */
+    void worker();
+
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::deque<Job> m_queue;
+    // Number of worker threads that are currently running.
+    size_t m_running;
+    // Configuration and counters, protected by the mutex.
+    CallPoolStats m_stats;
+};
@@ -0,0 +1,36 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bindings.hpp"
+#include <cstring>
+
+/** Find the binding of a symbol with the given signature. */
+const Binding *find_binding(const char *symbol, const CType &rtype,
+                            const CType *const *types, size_t nargs) {
+    for (auto &binding : generated_bindings()) {
+        if (strcmp(binding.symbol, symbol) != 0)
+            continue;
+        if (binding.rtype != rtype.tag() || binding.nargs != nargs)
+            continue;
+
+        bool match = true;
+        for (size_t i = 0; i < nargs; i++)
+            match = match && binding.argtypes[i] == types[i]->tag();
+        if (match)
+            return &binding;
+    }
+    return nullptr;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "pointer.hpp"
+#include "types.hpp"
+#include <cstddef>
+#include <lean/lean.h>
+#include <span>
+#include <utility>
+
+/**
+ * Call a function with an array of Lean CValue objects.
+ *
+ * The values must already have the types of the binding.
+ */
+typedef lean_obj_res (*BindingShim)(void *fn, b_lean_obj_arg args);
+
+/**
+ * A function with a signature that is known at build time.
+ *
+ * The bindings are generated by the lake target `bindings_generated.o` from the
+ * manifest in `bindings.txt`. Each of them has a shim that calls the function
+ * directly, without libffi and without intermediate buffers.
+ */
+struct Binding {
+    // Name of the symbol.
+    const char *symbol;
+    // Return type and argument types.
+    ObjectTag rtype;
+    const ObjectTag *argtypes;
+    size_t nargs;
+    // Shim that calls the function.
+    BindingShim shim;
+};
+
+/** Get all generated bindings. */
+std::span<const Binding> generated_bindings();
+
+/**
+ * Find the binding of a symbol with the given signature.
+ *
+ * Returns nullptr if the function was not generated.
+ */
+const Binding *find_binding(const char *symbol, const CType &rtype,
+                            const CType *const *types, size_t nargs);
+
+/** C type of arguments and return values of bindings. */
+template <ObjectTag Tag> struct BindingType {
+    using type = typename TagToType<Tag>::type;
+};
+template <> struct BindingType<VOID> {
+    using type = void;
+};
+template <> struct BindingType<POINTER> {
+    using type = void *;
+};
+
+/** Get the C value of a Lean CValue object with a type known at compile time. */
+template <ObjectTag Tag>
+typename BindingType<Tag>::type binding_unbox(b_lean_obj_arg obj) {
+    if constexpr (Tag >= INT8 && Tag <= INT64)
+        return CValueInt<Tag>(obj).value();
+    else if constexpr (Tag >= UINT8 && Tag <= UINT64)
+        return CValueNat<Tag>(obj).value();
+    else if constexpr (Tag >= FLOAT && Tag <= LONGDOUBLE)
+        return CValueFloat<Tag>(obj).value();
+    else if constexpr (Tag >= COMPLEX_FLOAT && Tag <= COMPLEX_LONGDOUBLE)
+        return CValueComplex<Tag>(obj).value();
+    else if constexpr (Tag == POINTER)
+        return Pointer::unbox(lean_ctor_get(obj, 0))->pointer();
+    else
+        static_assert(Tag == POINTER, "type can't be used in bindings");
+}
+
+template <ObjectTag R, ObjectTag... A, size_t... I>
+lean_obj_res binding_call_impl(void *fn, b_lean_obj_arg args,
+                               std::index_sequence<I...>) {
+    using F = typename BindingType<R>::type (*)(typename BindingType<A>::type...);
+    auto f = reinterpret_cast<F>(fn);
+    if constexpr (R == VOID) {
+        f(binding_unbox<A>(lean_array_get_core(args, I))...);
+        return lean_box(0);
+    } else {
+        auto result = f(binding_unbox<A>(lean_array_get_core(args, I))...);
+        return CValue::unmarshal(*CType::primitive(R), (const uint8_t *)&result);
+    }
+}
+
+/** Shim for a function `R f(A...)`. It is instantiated by the generated bindings. */
+template <ObjectTag R, ObjectTag... A>
+lean_obj_res binding_call(void *fn, b_lean_obj_arg args) {
+    auto indices = std::make_index_sequence<sizeof...(A)>{};
+    return binding_call_impl<R, A...>(fn, args, indices);
+}
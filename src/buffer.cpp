@@ -0,0 +1,113 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "buffer.hpp"
+#include "pointer.hpp"
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+// Set when the pool of the thread was destroyed. Buffers that are finalized after
+// that, e.g. during the thread exit, are freed directly.
+static thread_local bool t_pool_destroyed = false;
+
+/** Free all pooled blocks. */
+BufferPool::~BufferPool() {
+    for (auto &blocks : m_free) {
+        for (auto block : blocks)
+            free(block);
+    }
+    t_pool_destroyed = true;
+}
+
+/** Get the pool of the calling thread. */
+BufferPool *BufferPool::local() {
+    static thread_local BufferPool pool;
+    return t_pool_destroyed ? nullptr : &pool;
+}
+
+/** Get the size class of a block. */
+size_t BufferPool::size_class(size_t size) {
+    if (size > MIN_SIZE << (NUM_CLASSES - 1))
+        return NUM_CLASSES;
+    size = std::max(size, MIN_SIZE);
+    return std::bit_width(size - 1) - std::bit_width(MIN_SIZE - 1);
+}
+
+/** Allocate a block. */
+uint8_t *BufferPool::acquire(size_t size) {
+    size_t cls = size_class(size);
+    if (cls == NUM_CLASSES)
+        return (uint8_t *)malloc(std::max<size_t>(size, 1));
+
+    BufferPool *pool = local();
+    if (pool && !pool->m_free[cls].empty()) {
+        uint8_t *block = pool->m_free[cls].back();
+        pool->m_free[cls].pop_back();
+        return block;
+    }
+    return (uint8_t *)malloc(MIN_SIZE << cls);
+}
+
+/** Release a block. */
+void BufferPool::release(uint8_t *block, size_t size) {
+    size_t cls = size_class(size);
+    BufferPool *pool = cls == NUM_CLASSES ? nullptr : local();
+    if (pool && pool->m_free[cls].size() < MAX_FREE)
+        pool->m_free[cls].push_back(block);
+    else
+        free(block);
+}
+
+/** Allocate the buffer. */
+Buffer::Buffer(size_t size, bool zero)
+    : m_data(BufferPool::acquire(size)), m_size(size) {
+    if (m_data == nullptr)
+        throw std::runtime_error("out of memory");
+    if (zero)
+        memset(m_data, 0, size);
+}
+
+/**
+ * Allocate a buffer.
+ *
+ * All arguments are borrowed.
+ */
+extern "C" lean_obj_res Buffer_mk(b_lean_obj_arg size_obj, uint8_t zero,
+                                  lean_object *unused) {
+    try {
+        auto buffer = new Buffer(lean_usize_of_nat(size_obj), zero);
+        return lean_io_result_mk_ok(buffer->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Get a pointer to the buffer.
+ *
+ * The pointer keeps the buffer alive.
+ */
+extern "C" lean_obj_res Buffer_pointer(b_lean_obj_arg buffer_obj) {
+    return (new Pointer(Buffer::unbox(buffer_obj)->data(), buffer_obj))->box();
+}
+
+/** Get the size of the buffer. */
+extern "C" lean_obj_res Buffer_size(b_lean_obj_arg buffer_obj) {
+    return lean_usize_to_nat(Buffer::unbox(buffer_obj)->size());
+}
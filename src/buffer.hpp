@@ -0,0 +1,99 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "external_type.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <lean/lean.h>
+#include <vector>
+
+/**
+ * Free lists of blocks in size classes.
+ *
+ * Every thread has its own pool, so allocating and releasing small blocks needs
+ * neither a lock nor a call to malloc(). Blocks can be released on a different
+ * thread than the one that allocated them. Larger blocks are not pooled.
+ */
+class BufferPool {
+  public:
+    /** Size of the smallest class. Classes are powers of two. */
+    static constexpr size_t MIN_SIZE = 16;
+    /** Number of size classes, the largest one is 4096 bytes. */
+    static constexpr size_t NUM_CLASSES = 9;
+    /** Maximum number of free blocks kept in each class. */
+    static constexpr size_t MAX_FREE = 64;
+
+    BufferPool() = default;
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    /**
+     * Allocate a block of at least `size` bytes.
+     *
+     * Returns nullptr if the allocation fails.
+     */
+    static uint8_t *acquire(size_t size);
+
+    /** Release a block of `size` bytes that was returned by acquire(). */
+    static void release(uint8_t *block, size_t size);
+
+  private:
+    /** Get the pool of the calling thread, or nullptr while the thread exits. */
+    static BufferPool *local();
+
+    /** Get the size class of a block, or NUM_CLASSES if it isn't pooled. */
+    static size_t size_class(size_t size);
+
+    std::array<std::vector<uint8_t *>, NUM_CLASSES> m_free;
+};
+
+/**
+ * Buffer that is freed when it is finalized.
+ *
+ * Small buffers are taken from the BufferPool of the thread.
+ */
+class Buffer final : public ExternalType<Buffer> {
+  public:
+    /**
+     * Allocate a buffer of `size` bytes, filled with zeros if `zero` is set.
+     *
+     * Raises an exception if the allocation fails.
+     */
+    Buffer(size_t size, bool zero);
+
+    ~Buffer() { BufferPool::release(m_data, m_size); }
+
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+
+    /** Get the address of the buffer. */
+    uint8_t *data() const { return m_data; }
+
+    /** Get the size of the buffer. */
+    size_t size() const { return m_size; }
+
+    /** No children. */
+    const std::vector<lean_object *> children() { return {}; }
+
+  private:
+    uint8_t *m_data;
+    size_t m_size;
+};
@@ -17,37 +17,38 @@
 #include "callback.hpp"
 #include "lean/lean.h"
 #include "pointer.hpp"
+#include "thread.hpp"
 #include <ffi.h>
 #include <stdexcept>
 
+/** Get the interned types of an array of Lean CType objects. */
+static std::vector<const CType *> unbox_types(b_lean_obj_arg types_obj) {
+    std::vector<const CType *> types;
+    for (size_t i = 0; i < lean_array_size(types_obj); i++)
+        types.push_back(CType::unbox(lean_array_get_core(types_obj, i)));
+    return types;
+}
+
 /** Create the callback option. */
 Callback::Callback(b_lean_obj_arg rtype_obj, b_lean_obj_arg args_obj,
                    lean_obj_arg cb_obj)
-    : m_cb_obj(cb_obj), m_rtype(CType::unbox(rtype_obj)) {
+    : Callback(CType::unbox(rtype_obj), unbox_types(args_obj), cb_obj, binding) {}
 
-    size_t nargs = lean_array_size(args_obj);
-    m_ffi_argtypes = new ffi_type *[nargs];
-    for (size_t i = 0; i < nargs; i++) {
-        m_argtypes.push_back(CType::unbox(lean_array_get_core(args_obj, i)));
-        m_ffi_argtypes[i] = m_argtypes[i]->ffitype();
-    }
-    m_closure = (ffi_closure *)ffi_closure_alloc(sizeof(ffi_closure), &m_function);
-    if (m_closure == nullptr)
-        lean_internal_panic("ffi_closure_alloc() failed");
+/** Create the closure with a binding function. */
+Callback::Callback(const CType *rtype, const std::vector<const CType *> &argtypes,
+                   lean_obj_arg cb_obj, Binding binding)
+    : m_cb_obj(cb_obj), m_signature(Signature::get(rtype, argtypes)) {
 
-    ffi_status status = ffi_prep_cif(&m_cif, FFI_DEFAULT_ABI, nargs, m_rtype->ffitype(),
-                                     m_ffi_argtypes);
-    if (status != FFI_OK)
-        throw std::runtime_error("ffi_prep_cif() failed");
-
-    status = ffi_prep_closure_loc(m_closure, &m_cif, binding, this, m_function);
-    if (status != FFI_OK)
+    m_closure = ClosurePool::global().acquire(&m_function);
+    ffi_status status =
+        ffi_prep_closure_loc(m_closure, m_signature->cif(), binding, this, m_function);
+    if (status != FFI_OK) {
+        ClosurePool::global().release(m_closure, m_function);
         throw std::runtime_error("ffi_prep_closure_loc() failed");
+    }
 
-    // TODO: Not sure why this is necessary. We should already own the object, but
-    //       without it the reference count appears to be off and we can't decrease
-    //       it in the destructor.
-    lean_inc(m_cb_obj);
+    // The callback can be called from several threads at the same time.
+    lean_mark_mt(m_cb_obj);
 }
 
 /**
@@ -55,28 +56,70 @@ Callback::Callback(b_lean_obj_arg rtype_obj, b_lean_obj_arg args_obj,
  */
 Callback::~Callback() {
     lean_dec(m_cb_obj);
-    delete[] m_ffi_argtypes;
-    ffi_closure_free(m_closure);
+    ClosurePool::global().release(m_closure, m_function);
+}
+
+/**
+ * Write the return value of a closure.
+ *
+ * libffi expects integers smaller than a register to be widened to ffi_arg.
+ */
+static void write_return(const CType &type, b_lean_obj_arg value, void *ret) {
+    switch (type.tag()) {
+    case INT8:
+        *(ffi_sarg *)ret = CValueInt<INT8>(value).value();
+        break;
+    case INT16:
+        *(ffi_sarg *)ret = CValueInt<INT16>(value).value();
+        break;
+    case INT32:
+        *(ffi_sarg *)ret = CValueInt<INT32>(value).value();
+        break;
+    case UINT8:
+        *(ffi_arg *)ret = CValueNat<UINT8>(value).value();
+        break;
+    case UINT16:
+        *(ffi_arg *)ret = CValueNat<UINT16>(value).value();
+        break;
+    case UINT32:
+        *(ffi_arg *)ret = CValueNat<UINT32>(value).value();
+        break;
+    default:
+        CValue::marshal(type, value, (uint8_t *)ret);
+    }
 }
 
 /** Callback wrapper. */
 void Callback::binding(ffi_cif *cif, void *ret, void *args[], void *data) {
     Callback *this_ = static_cast<Callback *>(data);
-    assert(cif == &this_->m_cif);
+    auto &signature = *this_->m_signature;
+    assert(cif == signature.cif());
+
+    // The closure might be called from a thread of a C library.
+    LeanThread::ensure();
 
-    size_t nargs = this_->m_argtypes.size();
-    std::vector<std::unique_ptr<CValue>> args_vec;
+    // Create the Lean objects directly from the argument buffers of libffi.
+    auto &argtypes = signature.argtypes();
+    size_t nargs = argtypes.size();
     lean_object *args_obj = lean_alloc_array(nargs, nargs);
     for (size_t i = 0; i < nargs; i++) {
-        args_vec.push_back(
-            CValue::from_buffer(*this_->m_argtypes[i], (uint8_t *)args[i]));
-        lean_array_set_core(args_obj, i, args_vec[i]->box());
+        auto arg = CValue::unmarshal(*argtypes[i], (uint8_t *)args[i]);
+        lean_array_set_core(args_obj, i, arg);
     }
 
+    // The function object is consumed by the application.
+    lean_inc(this_->m_cb_obj);
     lean_object *result = lean_apply_2(this_->m_cb_obj, args_obj, lean_io_mk_world());
-    // TODO: How do we handle exceptions?
-    assert(lean_io_result_is_ok(result));
+    // There is no way to report the error to the C caller.
+    if (lean_io_result_is_error(result)) {
+        lean_io_result_show_error(result);
+        lean_internal_panic("callback raised an exception");
+    }
 
-    auto buffer = CValue::unbox(lean_io_result_get_value(result))->to_buffer();
-    memcpy(ret, buffer.get(), this_->m_rtype->size());
+    // Write the result directly to the return buffer of libffi.
+    lean_object *value = lean_io_result_get_value(result);
+    if (!CValue::matches(*signature.rtype(), value))
+        lean_internal_panic("callback returned a value of the wrong type");
+    write_return(*signature.rtype(), value, ret);
+    lean_dec(result);
 }
@@ -16,12 +16,55 @@
 
 #pragma once
 
+#include "signature.hpp"
+#include "thread.hpp"
 #include "types.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
 #include <ffi.h>
 #include <lean/lean.h>
 #include <memory>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+/**
+ * Scalars that are passed to typed closures without a CValue.
+ *
+ * `double` is a Lean `Float`, pointers are `USize` addresses and `int` is a Lean
+ * `Int`. The tag is the CType of the C value.
+ */
+template <typename T> struct LeanScalar;
+
+template <> struct LeanScalar<double> {
+    static constexpr ObjectTag tag = DOUBLE;
+    static lean_obj_res box(double value) { return lean_box_float(value); }
+    static double unbox(b_lean_obj_arg obj) { return lean_unbox_float(obj); }
+};
+
+template <> struct LeanScalar<void *> {
+    static constexpr ObjectTag tag = POINTER;
+    static lean_obj_res box(void *value) { return lean_box_usize((size_t)value); }
+    static void *unbox(b_lean_obj_arg obj) { return (void *)lean_unbox_usize(obj); }
+};
+
+template <> struct LeanScalar<int> {
+    static constexpr ObjectTag tag = INT32;
+    static lean_obj_res box(int value) { return lean_int_to_int(value); }
+    static int unbox(b_lean_obj_arg obj) {
+        // Values outside of the range are clamped. Comparators only need the sign.
+        if (!lean_is_scalar(obj))
+            return lean_int_lt(obj, lean_box(0)) ? INT_MIN : INT_MAX;
+        return (int)std::clamp<int64_t>(lean_scalar_to_int64(obj), INT_MIN, INT_MAX);
+    }
+};
+
+template <> struct LeanScalar<void> {
+    static constexpr ObjectTag tag = VOID;
+};
+
 /**
  * Callback function.
  *
@@ -32,8 +75,20 @@
  */
 class Callback {
   public:
+    /** Create a callback for a `Callback` function in Lean. */
     Callback(b_lean_obj_arg rtype_obj, b_lean_obj_arg args_obj, lean_obj_arg cb_obj);
 
+    /**
+     * Create a callback for a Lean function `A... → IO R`.
+     *
+     * The arguments and the return value are passed as Lean scalars, see LeanScalar.
+     */
+    template <typename R, typename... A> static Callback *typed(lean_obj_arg cb_obj) {
+        std::vector<const CType *> argtypes = {CType::primitive(LeanScalar<A>::tag)...};
+        return new Callback(CType::primitive(LeanScalar<R>::tag), argtypes, cb_obj,
+                            typed_binding<R, A...>);
+    }
+
     ~Callback();
 
     std::unique_ptr<Pointer> pointer() {
@@ -41,15 +96,53 @@ class Callback {
     }
 
   private:
+    using Binding = void (*)(ffi_cif *, void *, void **, void *);
+
+    Callback(const CType *rtype, const std::vector<const CType *> &argtypes,
+             lean_obj_arg cb_obj, Binding binding);
+
     /** Callback wrapper. */
     static void binding(ffi_cif *cif, void *ret, void *args[], void *data);
 
+    /** Callback wrapper for typed closures. */
+    template <typename R, typename... A>
+    static void typed_binding(ffi_cif *cif, void *ret, void *args[], void *data) {
+        typed_binding<R, A...>(static_cast<Callback *>(data), ret, args,
+                               std::index_sequence_for<A...>{});
+    }
+
+    template <typename R, typename... A, size_t... I>
+    static void typed_binding(Callback *this_, void *ret, void *args[],
+                              std::index_sequence<I...>) {
+        LeanThread::ensure();
+
+        // The function object is consumed by the application.
+        lean_inc(this_->m_cb_obj);
+        lean_object *objs[] = {LeanScalar<A>::box(*(A *)args[I])...,
+                               lean_io_mk_world()};
+        lean_object *result = lean_apply_n(this_->m_cb_obj, sizeof...(A) + 1, objs);
+        // There is no way to report the error to the C caller.
+        if (lean_io_result_is_error(result)) {
+            lean_io_result_show_error(result);
+            lean_internal_panic("callback raised an exception");
+        }
+
+        // Integers smaller than a register are widened like in Callback::binding.
+        if constexpr (!std::is_void_v<R>) {
+            R value = LeanScalar<R>::unbox(lean_io_result_get_value(result));
+            if constexpr (std::is_integral_v<R> && sizeof(R) < sizeof(ffi_arg))
+                *(ffi_sarg *)ret = value;
+            else
+                *(R *)ret = value;
+        }
+        lean_dec(result);
+    }
+
   private:
     lean_object *m_cb_obj;
-    ffi_cif m_cif;
+    // Types and CIF, shared with other closures of the same signature.
+    std::shared_ptr<Signature> m_signature;
+    // Closure from the pool and the address of its code.
     ffi_closure *m_closure;
     void *m_function;
-    std::unique_ptr<CType> m_rtype;
-    std::vector<std::unique_ptr<CType>> m_argtypes;
-    ffi_type **m_ffi_argtypes;
 };
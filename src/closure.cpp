@@ -17,6 +17,7 @@
 #include "closure.hpp"
 #include "lean/lean.h"
 #include "pointer.hpp"
+#include "signature.hpp"
 #include <stdexcept>
 
 /** Create a closure. */
@@ -30,6 +31,40 @@ extern "C" lean_obj_res Closure_mk(b_lean_obj_arg rtype_obj, b_lean_obj_arg args
     }
 }
 
+/** Create a closure that passes scalars directly to a Lean function `A... → IO R`. */
+template <typename R, typename... A> static lean_obj_res mk_typed(lean_obj_arg cb_obj) {
+    try {
+        auto closure = new Closure(Callback::typed<R, A...>(cb_obj));
+        return lean_io_result_mk_ok(closure->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Create a closure `double f(double)`. */
+extern "C" lean_obj_res Closure_mkDoubleUnary(lean_obj_arg cb_obj,
+                                              lean_object *unused) {
+    return mk_typed<double, double>(cb_obj);
+}
+
+/** Create a closure `double f(double, double)`. */
+extern "C" lean_obj_res Closure_mkDoubleBinary(lean_obj_arg cb_obj,
+                                               lean_object *unused) {
+    return mk_typed<double, double, double>(cb_obj);
+}
+
+/** Create a closure `int f(const void *, const void *)`. */
+extern "C" lean_obj_res Closure_mkComparator(lean_obj_arg cb_obj, lean_object *unused) {
+    return mk_typed<int, void *, void *>(cb_obj);
+}
+
+/** Create a closure `void f(void *)`. */
+extern "C" lean_obj_res Closure_mkPointerAction(lean_obj_arg cb_obj,
+                                                lean_object *unused) {
+    return mk_typed<void, void *>(cb_obj);
+}
+
 /** Mark the closure for deletion. */
 extern "C" lean_obj_res Closure_delete(b_lean_obj_arg closure_obj,
                                        lean_object *unused) {
@@ -42,3 +77,13 @@ extern "C" lean_obj_res Closure_pointer(b_lean_obj_arg closure_obj) {
     // Release the object before boxing. Once boxed, cleanup will be handled by Lean.
     return Closure::unbox(closure_obj)->pointer().release()->box();
 }
+
+/** Get the statistics of the closure pool. */
+extern "C" lean_obj_res Closure_poolStats(lean_object *unused) {
+    auto &pool = ClosurePool::global();
+    lean_object *stats = lean_alloc_ctor(0, 3, 0);
+    lean_ctor_set(stats, 0, lean_usize_to_nat(pool.allocated()));
+    lean_ctor_set(stats, 1, lean_usize_to_nat(pool.available()));
+    lean_ctor_set(stats, 2, lean_usize_to_nat(Signature::count()));
+    return lean_io_result_mk_ok(stats);
+}
@@ -18,6 +18,7 @@
 
 #include "callback.hpp"
 #include "external_type.hpp"
+#include "thread.hpp"
 #include "types.hpp"
 #include <ffi.h>
 #include <lean/lean.h>
@@ -29,7 +30,14 @@ class Closure final : public ExternalType<Closure> {
   public:
     /** Create a closure from a callback function and argument spec. */
     Closure(b_lean_obj_arg rtype_obj, b_lean_obj_arg args_obj, lean_obj_arg cb_obj)
-        : m_callback(new Callback(rtype_obj, args_obj, cb_obj)) {}
+        : m_delete(false), m_callback(new Callback(rtype_obj, args_obj, cb_obj)) {
+        LeanThread::enter();
+    }
+
+    /** Create a closure from an existing callback. */
+    Closure(Callback *callback) : m_delete(false), m_callback(callback) {
+        LeanThread::enter();
+    }
 
     /**
      * Delete the callback only when it is marked for deletion.
@@ -0,0 +1,230 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "convert.hpp"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/** Convert values of any supported type one by one. */
+template <typename T>
+static void to_double_scalar(const uint8_t *src, double *dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        T value;
+        memcpy(&value, src + i * sizeof(T), sizeof(T));
+        dst[i] = (double)value;
+    }
+}
+
+/** Truncate and saturate a double to an integer type. */
+template <typename T> static T saturate(double value) {
+    if (std::isnan(value))
+        return 0;
+    if (value <= (double)std::numeric_limits<T>::min())
+        return std::numeric_limits<T>::min();
+    if (value >= (double)std::numeric_limits<T>::max())
+        return std::numeric_limits<T>::max();
+    return (T)value;
+}
+
+/** Convert doubles to any supported type one by one. */
+template <typename T>
+static void from_double_scalar(const double *src, uint8_t *dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        T value;
+        if constexpr (std::is_integral_v<T>)
+            value = saturate<T>(src[i]);
+        else
+            value = (T)src[i];
+        memcpy(dst + i * sizeof(T), &value, sizeof(T));
+    }
+}
+
+#if defined(__SSE2__)
+/** Convert four packed int32 values and store them. */
+static inline void store_epi32(double *dst, __m128i v) {
+    _mm_storeu_pd(dst, _mm_cvtepi32_pd(v));
+    _mm_storeu_pd(dst + 2, _mm_cvtepi32_pd(_mm_srli_si128(v, 8)));
+}
+
+/** Convert eight packed int16 values, sign or zero extended. */
+template <bool Signed> static inline void store_epi16(double *dst, __m128i v) {
+    __m128i lo, hi;
+    if constexpr (Signed) {
+        lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    } else {
+        lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+        hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+    }
+    store_epi32(dst, lo);
+    store_epi32(dst + 4, hi);
+}
+
+/** Convert sixteen packed int8 values, sign or zero extended. */
+template <bool Signed> static inline void store_epi8(double *dst, __m128i v) {
+    __m128i lo, hi;
+    if constexpr (Signed) {
+        lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+        hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+    } else {
+        lo = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+        hi = _mm_unpackhi_epi8(v, _mm_setzero_si128());
+    }
+    // Both halves are in range of int16 now.
+    store_epi16<true>(dst, lo);
+    store_epi16<true>(dst + 8, hi);
+}
+
+/**
+ * Convert the first part of an array with SSE2.
+ *
+ * Returns the number of converted values. The rest is converted by the caller.
+ */
+static size_t to_double_sse2(ObjectTag tag, const uint8_t *src, double *dst,
+                             size_t count) {
+    size_t i = 0;
+    switch (tag) {
+    case INT8:
+        for (; i + 16 <= count; i += 16)
+            store_epi8<true>(dst + i, _mm_loadu_si128((const __m128i *)(src + i)));
+        break;
+    case UINT8:
+        for (; i + 16 <= count; i += 16)
+            store_epi8<false>(dst + i, _mm_loadu_si128((const __m128i *)(src + i)));
+        break;
+    case INT16:
+        for (; i + 8 <= count; i += 8)
+            store_epi16<true>(dst + i, _mm_loadu_si128((const __m128i *)(src + 2 * i)));
+        break;
+    case UINT16:
+        for (; i + 8 <= count; i += 8)
+            store_epi16<false>(dst + i,
+                               _mm_loadu_si128((const __m128i *)(src + 2 * i)));
+        break;
+    case INT32:
+        for (; i + 4 <= count; i += 4)
+            store_epi32(dst + i, _mm_loadu_si128((const __m128i *)(src + 4 * i)));
+        break;
+    case FLOAT:
+        for (; i + 4 <= count; i += 4) {
+            __m128 v = _mm_loadu_ps((const float *)(src + 4 * i));
+            _mm_storeu_pd(dst + i, _mm_cvtps_pd(v));
+            _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+        }
+        break;
+    default:
+        break;
+    }
+    return i;
+}
+
+/** Convert the first part of an array of doubles with SSE2. */
+static size_t from_double_sse2(ObjectTag tag, const double *src, uint8_t *dst,
+                               size_t count) {
+    size_t i = 0;
+    if (tag == FLOAT) {
+        for (; i + 4 <= count; i += 4) {
+            __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+            __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+            _mm_storeu_ps((float *)(dst + 4 * i), _mm_movelh_ps(lo, hi));
+        }
+    }
+    return i;
+}
+#endif
+
+/** Convert values of a scalar type to double. */
+void convert_to_double(const CType &type, const uint8_t *src, double *dst,
+                       size_t count) {
+    size_t done = 0;
+#if defined(__SSE2__)
+    done = to_double_sse2(type.tag(), src, dst, count);
+#endif
+    src += done * type.size();
+    dst += done;
+    count -= done;
+
+    switch (type.tag()) {
+    case INT8:
+        return to_double_scalar<int8_t>(src, dst, count);
+    case INT16:
+        return to_double_scalar<int16_t>(src, dst, count);
+    case INT32:
+        return to_double_scalar<int32_t>(src, dst, count);
+    case INT64:
+        return to_double_scalar<int64_t>(src, dst, count);
+    case UINT8:
+        return to_double_scalar<uint8_t>(src, dst, count);
+    case UINT16:
+        return to_double_scalar<uint16_t>(src, dst, count);
+    case UINT32:
+        return to_double_scalar<uint32_t>(src, dst, count);
+    case UINT64:
+        return to_double_scalar<uint64_t>(src, dst, count);
+    case FLOAT:
+        return to_double_scalar<float>(src, dst, count);
+    case DOUBLE:
+        memcpy(dst, src, count * sizeof(double));
+        return;
+    default:
+        throw std::runtime_error("type can't be converted to Float");
+    }
+}
+
+/** Convert doubles to a scalar type. */
+void convert_from_double(const CType &type, const double *src, uint8_t *dst,
+                         size_t count) {
+    size_t done = 0;
+#if defined(__SSE2__)
+    done = from_double_sse2(type.tag(), src, dst, count);
+#endif
+    src += done;
+    dst += done * type.size();
+    count -= done;
+
+    switch (type.tag()) {
+    case INT8:
+        return from_double_scalar<int8_t>(src, dst, count);
+    case INT16:
+        return from_double_scalar<int16_t>(src, dst, count);
+    case INT32:
+        return from_double_scalar<int32_t>(src, dst, count);
+    case INT64:
+        return from_double_scalar<int64_t>(src, dst, count);
+    case UINT8:
+        return from_double_scalar<uint8_t>(src, dst, count);
+    case UINT16:
+        return from_double_scalar<uint16_t>(src, dst, count);
+    case UINT32:
+        return from_double_scalar<uint32_t>(src, dst, count);
+    case UINT64:
+        return from_double_scalar<uint64_t>(src, dst, count);
+    case FLOAT:
+        return from_double_scalar<float>(src, dst, count);
+    case DOUBLE:
+        memcpy(dst, src, count * sizeof(double));
+        return;
+    default:
+        throw std::runtime_error("type can't be converted from Float");
+    }
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Convert `count` values of a scalar type to double.
+ *
+ * Supported types are the integer types, FLOAT and DOUBLE. Common conversions use
+ * SSE2 on x86_64, everything else is a plain loop. Raises an exception for other
+ * types.
+ */
+void convert_to_double(const CType &type, const uint8_t *src, double *dst,
+                       size_t count);
+
+/**
+ * Convert `count` doubles to a scalar type.
+ *
+ * Integers are truncated towards zero and saturated to the range of the type. NaN is
+ * converted to 0.
+ */
+void convert_from_double(const CType &type, const double *src, uint8_t *dst,
+                         size_t count);
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "direct.hpp"
+#include "types.hpp"
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace {
+
+/** Classes of types with a different calling convention. */
+enum Kind { KIND_VOID, KIND_INT, KIND_FLOAT, KIND_DOUBLE, KIND_NONE };
+
+/** Get the class of a type. */
+Kind kind_of(const CType &type) {
+    switch (type.tag()) {
+    case VOID:
+        return KIND_VOID;
+    case INT8:
+    case INT16:
+    case INT32:
+    case INT64:
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case POINTER:
+        return KIND_INT;
+    case FLOAT:
+        return KIND_FLOAT;
+    case DOUBLE:
+        return KIND_DOUBLE;
+    default:
+        return KIND_NONE;
+    }
+}
+
+/** Read an argument and widen integers to 64 bit with the correct extension. */
+template <typename T> T load(const void *value, const CType *type) {
+    if constexpr (std::is_same_v<T, int64_t>) {
+        switch (type->tag()) {
+        case INT8:
+            return *(const int8_t *)value;
+        case INT16:
+            return *(const int16_t *)value;
+        case INT32:
+            return *(const int32_t *)value;
+        case UINT8:
+            return *(const uint8_t *)value;
+        case UINT16:
+            return *(const uint16_t *)value;
+        case UINT32:
+            return *(const uint32_t *)value;
+        default:
+            return *(const int64_t *)value;
+        }
+    } else {
+        return *(const T *)value;
+    }
+}
+
+/** Call the function with the argument types `A` and the return type `R`. */
+template <typename R, typename... A, size_t... I>
+void call(void *fn, void *rvalue, void **argvals, const CType *const *types,
+          std::index_sequence<I...>) {
+    auto f = reinterpret_cast<R (*)(A...)>(fn);
+    if constexpr (std::is_void_v<R>) {
+        f(load<A>(argvals[I], types[I])...);
+    } else {
+        // Like ffi_call(), integers are returned as a full register.
+        *(R *)rvalue = f(load<A>(argvals[I], types[I])...);
+    }
+}
+
+template <typename R, typename... A>
+void thunk(void *fn, void *rvalue, void **argvals, const CType *const *types) {
+    call<R, A...>(fn, rvalue, argvals, types, std::index_sequence_for<A...>{});
+}
+
+/**
+ * Every signature is encoded as the sequence of the kinds of the return value and of
+ * the arguments, with two bits each. A leading one bit separates signatures with a
+ * different number of arguments.
+ */
+constexpr size_t TABLE_SIZE = size_t(1) << (2 * (DIRECT_MAX_ARGS + 1) + 1);
+using Table = std::array<DirectThunk, TABLE_SIZE>;
+
+constexpr size_t append(size_t key, Kind kind) { return (key << 2) | kind; }
+
+/** Add the thunk for `R(A...)` and all thunks with more arguments. */
+template <typename R, typename... A> constexpr void fill(Table &table, size_t key) {
+    table[key] = &thunk<R, A...>;
+    if constexpr (sizeof...(A) < DIRECT_MAX_ARGS) {
+        fill<R, A..., int64_t>(table, append(key, KIND_INT));
+        fill<R, A..., float>(table, append(key, KIND_FLOAT));
+        fill<R, A..., double>(table, append(key, KIND_DOUBLE));
+    }
+}
+
+constexpr Table make_table() {
+    Table table{};
+    fill<void>(table, append(1, KIND_VOID));
+    fill<int64_t>(table, append(1, KIND_INT));
+    fill<float>(table, append(1, KIND_FLOAT));
+    fill<double>(table, append(1, KIND_DOUBLE));
+    return table;
+}
+
+constexpr Table thunks = make_table();
+
+} // namespace
+
+/** Find the thunk for a signature. */
+DirectThunk direct_thunk(const CType &rtype, const CType *const *types, size_t nargs) {
+    if (!DIRECT_CALLS_SUPPORTED || nargs > DIRECT_MAX_ARGS)
+        return nullptr;
+
+    Kind rkind = kind_of(rtype);
+    if (rkind == KIND_NONE)
+        return nullptr;
+
+    size_t key = append(1, rkind);
+    for (size_t i = 0; i < nargs; i++) {
+        Kind kind = kind_of(*types[i]);
+        if (kind == KIND_NONE || kind == KIND_VOID)
+            return nullptr;
+        key = append(key, kind);
+    }
+    return thunks[key];
+}
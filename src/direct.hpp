@@ -0,0 +1,56 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+
+/**
+ * Direct calls for simple signatures.
+ *
+ * Functions with at most DIRECT_MAX_ARGS integer, pointer, float or double arguments
+ * and a void, integer, pointer, float or double return value are called through a
+ * thunk that casts the pointer to the matching C function type. This avoids the
+ * generic ffi_call() for the most common signatures.
+ *
+ * Integers and pointers are passed as 64 bit values in general purpose registers.
+ * This is only valid for ABIs where all these arguments are passed in registers, so
+ * the thunks are disabled on other platforms.
+ */
+#if defined(__x86_64__) || defined(__aarch64__)
+#define DIRECT_CALLS_SUPPORTED 1
+#else
+#define DIRECT_CALLS_SUPPORTED 0
+#endif
+
+/** Maximum number of arguments of a direct call. */
+constexpr size_t DIRECT_MAX_ARGS = 4;
+
+/**
+ * Call a function pointer with arguments and return value like ffi_call().
+ *
+ * `types` are the types of the arguments. They are needed to widen integers.
+ */
+typedef void (*DirectThunk)(void *fn, void *rvalue, void **argvals,
+                            const CType *const *types);
+
+/**
+ * Find the thunk for a signature.
+ *
+ * Returns nullptr if the signature has no thunk and has to be called with libffi.
+ */
+DirectThunk direct_thunk(const CType &rtype, const CType *const *types, size_t nargs);
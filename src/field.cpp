@@ -0,0 +1,114 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "field.hpp"
+#include "pointer.hpp"
+#include <stdexcept>
+
+/**
+ * Resolve a path of element indices.
+ *
+ * The Lean type object is walked together with the interned type, so the type of
+ * the field can be returned to Lean without converting it.
+ */
+FieldPath::FieldPath(b_lean_obj_arg type_obj, b_lean_obj_arg path_obj)
+    : m_offset(0), m_type(CType::unbox(type_obj)), m_type_obj(type_obj) {
+
+    for (size_t i = 0; i < lean_array_size(path_obj); i++) {
+        if (m_type->tag() != STRUCT)
+            throw std::runtime_error("field path indexes a non-struct type");
+
+        auto &elements = dynamic_cast<const CTypeStruct &>(*m_type).elements();
+        lean_object *index_obj = lean_array_get_core(path_obj, i);
+        if (!lean_is_scalar(index_obj) || lean_unbox(index_obj) >= elements.size())
+            throw std::runtime_error("field index out of range");
+
+        size_t index = lean_unbox(index_obj);
+        if (index >= m_type->offsets().size())
+            throw std::runtime_error("invalid struct type");
+        m_offset += m_type->offsets()[index];
+        m_type = elements[index];
+        m_type_obj = lean_array_get_core(lean_ctor_get(m_type_obj, 0), index);
+    }
+
+    // Only take the reference once nothing can throw anymore.
+    lean_inc(m_type_obj);
+}
+
+/**
+ * Compile a field path.
+ *
+ * All arguments are borrowed.
+ */
+extern "C" lean_obj_res FieldPath_mk(b_lean_obj_arg type_obj, b_lean_obj_arg path_obj,
+                                     lean_object *unused) {
+    try {
+        return lean_io_result_mk_ok((new FieldPath(type_obj, path_obj))->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Get the offset of the field. */
+extern "C" lean_obj_res FieldPath_offset(b_lean_obj_arg path_obj) {
+    return lean_usize_to_nat(FieldPath::unbox(path_obj)->offset());
+}
+
+/** Get the type of the field. */
+extern "C" lean_obj_res FieldPath_type(b_lean_obj_arg path_obj) {
+    lean_object *type = FieldPath::unbox(path_obj)->type_obj();
+    lean_inc(type);
+    return type;
+}
+
+/**
+ * Read a single field of a struct.
+ */
+extern "C" lean_obj_res Pointer_readField(b_lean_obj_arg ptr_obj,
+                                          b_lean_obj_arg path_obj,
+                                          lean_object *unused) {
+    auto path = FieldPath::unbox(path_obj);
+    try {
+        uint8_t *field = Pointer::unbox(ptr_obj)->pointer() + path->offset();
+        return lean_io_result_mk_ok(CValue::unmarshal(path->type(), field));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Write a single field of a struct.
+ *
+ * The value has to have the type of the field.
+ */
+extern "C" lean_obj_res Pointer_writeField(b_lean_obj_arg ptr_obj,
+                                           b_lean_obj_arg path_obj,
+                                           b_lean_obj_arg value_obj,
+                                           lean_object *unused) {
+    auto path = FieldPath::unbox(path_obj);
+    try {
+        if (!CValue::matches(path->type(), value_obj))
+            throw std::runtime_error("value type mismatch");
+        uint8_t *field = Pointer::unbox(ptr_obj)->pointer() + path->offset();
+        CValue::marshal(path->type(), value_obj, field);
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
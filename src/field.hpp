@@ -0,0 +1,66 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "external_type.hpp"
+#include "types.hpp"
+#include <cstddef>
+#include <lean/lean.h>
+#include <vector>
+
+/**
+ * Path to a field in nested structs.
+ *
+ * The path is resolved once to the offset of the field and its type, so reading or
+ * writing the field doesn't touch the rest of the struct.
+ */
+class FieldPath final : public ExternalType<FieldPath> {
+  public:
+    /**
+     * Resolve a path of element indices in a struct type.
+     *
+     * Raises an exception if an index is out of range or a non-struct type is
+     * indexed.
+     */
+    FieldPath(b_lean_obj_arg type_obj, b_lean_obj_arg path_obj);
+
+    ~FieldPath() { lean_dec(m_type_obj); }
+
+    FieldPath(const FieldPath &) = delete;
+    FieldPath &operator=(const FieldPath &) = delete;
+
+    /** Get the offset of the field from the start of the outermost struct. */
+    size_t offset() const { return m_offset; }
+
+    /** Get the type of the field. */
+    const CType &type() const { return *m_type; }
+
+    /** Get the Lean object of the type of the field. */
+    lean_object *type_obj() const { return m_type_obj; }
+
+    /** The type of the field is the only child, unless it is a scalar. */
+    const std::vector<lean_object *> children() {
+        if (lean_is_scalar(m_type_obj))
+            return {};
+        return {m_type_obj};
+    }
+
+  private:
+    size_t m_offset;
+    const CType *m_type;
+    lean_object *m_type_obj;
+};
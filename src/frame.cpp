@@ -0,0 +1,58 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame.hpp"
+#include <algorithm>
+
+/** Round up to a multiple of the alignment. */
+static inline size_t align_up(size_t offset, size_t alignment) {
+    alignment = std::max<size_t>(alignment, 1);
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Compute the layout of a frame.
+ *
+ * The return value is at the start of the buffer, followed by the arguments in
+ * order, each aligned to the alignment of its type.
+ */
+size_t CallFrame::layout(const CType &rtype, const CType *const *types, size_t nargs,
+                         size_t *offsets, size_t &alignment) {
+    size_t size = std::max(sizeof(ffi_arg), rtype.size());
+    alignment = std::max(alignof(ffi_arg), rtype.alignment());
+    for (size_t i = 0; i < nargs; i++) {
+        size = align_up(size, types[i]->alignment());
+        alignment = std::max(alignment, types[i]->alignment());
+        offsets[i] = size;
+        size += types[i]->size();
+    }
+    return size;
+}
+
+/** Allocate the frame in the arena. */
+CallFrame::CallFrame(const CType &rtype, const CType *const *types, size_t nargs)
+    : m_types(types) {
+
+    auto &arena = FrameArena::local();
+    m_argvals = arena.alloc_array<void *>(nargs);
+
+    size_t alignment;
+    auto offsets = arena.alloc_array<size_t>(nargs);
+    size_t size = layout(rtype, types, nargs, offsets, alignment);
+    m_data = arena.alloc(size, alignment);
+    for (size_t i = 0; i < nargs; i++)
+        m_argvals[i] = m_data + offsets[i];
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "arena.hpp"
+#include "types.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <ffi.h>
+#include <lean/lean.h>
+
+/**
+ * Return value and arguments of a single call in one contiguous buffer.
+ *
+ * The layout is computed from the types, and the arguments are written directly
+ * from their Lean objects into the buffer. The buffer is taken from the arena of
+ * the thread and released when the frame is destroyed.
+ */
+class CallFrame {
+  public:
+    CallFrame(const CType &rtype, const CType *const *types, size_t nargs);
+
+    /**
+     * Compute the layout of a frame without allocating it.
+     *
+     * Stores the offsets of the arguments in `offsets` and returns the size of the
+     * buffer. The return value is at offset 0.
+     */
+    static size_t layout(const CType &rtype, const CType *const *types, size_t nargs,
+                         size_t *offsets, size_t &alignment);
+
+    CallFrame(const CallFrame &) = delete;
+    CallFrame &operator=(const CallFrame &) = delete;
+
+    /** Write a Lean CValue object to the slot of an argument. */
+    void set(size_t i, b_lean_obj_arg value) {
+        CValue::marshal(*m_types[i], value, (uint8_t *)m_argvals[i]);
+    }
+
+    /** Write a pointer to the slot of a POINTER argument. */
+    void set_pointer(size_t i, void *pointer) { *(void **)m_argvals[i] = pointer; }
+
+    /** Buffer for the return value. It is at least as large as an ffi_arg. */
+    uint8_t *rvalue() { return m_data; }
+
+    /** Pointers to the argument values, as expected by ffi_call(). */
+    void **argvals() { return m_argvals; }
+
+  private:
+    // Has to be initialized first to release the buffers last.
+    FrameArena::Scope m_scope;
+    const CType *const *m_types;
+    void **m_argvals;
+    uint8_t *m_data;
+};
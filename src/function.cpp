@@ -0,0 +1,257 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "function.hpp"
+#include "frame.hpp"
+#include "lean/lean.h"
+#include "library.hpp"
+#include "pointer.hpp"
+#include "thread.hpp"
+#include "types.hpp"
+#include <stdexcept>
+
+/**
+ * Prepare the CIF for a function pointer.
+ *
+ * A nonempty `vargs_obj` prepares the CIF with ffi_prep_cif_var(), like in
+ * Pointer::call(). If `direct` is set, simple non-variadic signatures are called
+ * with a direct call thunk instead.
+ */
+ForeignFunction::ForeignFunction(b_lean_obj_arg pointer_obj, b_lean_obj_arg rtype_obj,
+                                 b_lean_obj_arg args_obj, b_lean_obj_arg vargs_obj,
+                                 bool direct)
+    : m_pointer_obj(pointer_obj), m_rtype(CType::unbox(rtype_obj)), m_thunk(nullptr),
+      m_binding(nullptr) {
+
+    size_t nfixed = lean_array_size(args_obj);
+    size_t nvar = lean_array_size(vargs_obj);
+    for (size_t i = 0; i < nfixed; i++)
+        m_argtypes.push_back(CType::unbox(lean_array_get_core(args_obj, i)));
+    for (size_t i = 0; i < nvar; i++)
+        m_argtypes.push_back(CType::unbox(lean_array_get_core(vargs_obj, i)));
+
+    for (auto tp : m_argtypes)
+        m_ffi_argtypes.push_back(tp->ffitype());
+
+    if (nvar == 0) {
+        ffi_status status = ffi_prep_cif(&m_cif, FFI_DEFAULT_ABI, nfixed,
+                                         m_rtype->ffitype(), m_ffi_argtypes.data());
+        if (status != FFI_OK)
+            throw std::runtime_error("ffi_prep_cif() failed");
+    } else {
+        ffi_status status =
+            ffi_prep_cif_var(&m_cif, FFI_DEFAULT_ABI, nfixed, nfixed + nvar,
+                             m_rtype->ffitype(), m_ffi_argtypes.data());
+        if (status != FFI_OK)
+            throw std::runtime_error("ffi_prep_cif_var() failed");
+    }
+
+    if (direct && nvar == 0)
+        m_thunk = direct_thunk(*m_rtype, m_argtypes.data(), nfixed);
+
+    // Only take the reference once nothing can throw anymore.
+    lean_inc(m_pointer_obj);
+}
+
+/** Check the number and the types of the arguments. */
+void ForeignFunction::check_args(b_lean_obj_arg args_obj) const {
+    size_t nargs = lean_array_size(args_obj);
+    if (nargs != m_argtypes.size())
+        throw std::runtime_error("wrong number of arguments");
+
+    for (size_t i = 0; i < nargs; i++) {
+        if (!CValue::matches(*m_argtypes[i], lean_array_get_core(args_obj, i)))
+            throw std::runtime_error("argument type mismatch");
+    }
+}
+
+/** Use the generated binding of a symbol. */
+void ForeignFunction::bind(const char *symbol) {
+    m_binding = find_binding(symbol, *m_rtype, m_argtypes.data(), m_argtypes.size());
+}
+
+/** Call the function with the values in a frame. */
+void ForeignFunction::invoke(CallFrame &frame) {
+    auto ptr = Pointer::unbox(m_pointer_obj);
+    if (m_thunk)
+        ptr->call(m_thunk, frame.rvalue(), frame.argvals(), m_argtypes.data());
+    else
+        ptr->call(&m_cif, frame.rvalue(), frame.argvals());
+}
+
+/** Call the function with an array of fixed and variadic CValue arguments. */
+lean_obj_res ForeignFunction::call(b_lean_obj_arg args_obj) {
+    check_args(args_obj);
+    if (m_binding) {
+        void *fn = Pointer::unbox(m_pointer_obj)->pointer();
+        LeanThread::enter();
+        return m_binding->shim(fn, args_obj);
+    }
+
+    size_t nargs = m_argtypes.size();
+    CallFrame frame(*m_rtype, m_argtypes.data(), nargs);
+    for (size_t i = 0; i < nargs; i++)
+        frame.set(i, lean_array_get_core(args_obj, i));
+
+    invoke(frame);
+    return CValue::unmarshal(*m_rtype, frame.rvalue());
+}
+
+/** Call the function once for every array of arguments. */
+lean_obj_res ForeignFunction::call_batch(b_lean_obj_arg batch_obj) {
+    size_t ncalls = lean_array_size(batch_obj);
+    for (size_t i = 0; i < ncalls; i++)
+        check_args(lean_array_get_core(batch_obj, i));
+
+    if (m_binding) {
+        void *fn = Pointer::unbox(m_pointer_obj)->pointer();
+        LeanThread::enter();
+        lean_object *results = lean_alloc_array(ncalls, ncalls);
+        for (size_t i = 0; i < ncalls; i++) {
+            lean_object *args_obj = lean_array_get_core(batch_obj, i);
+            lean_array_set_core(results, i, m_binding->shim(fn, args_obj));
+        }
+        return results;
+    }
+
+    size_t nargs = m_argtypes.size();
+    CallFrame frame(*m_rtype, m_argtypes.data(), nargs);
+
+    lean_object *results = lean_alloc_array(ncalls, ncalls);
+    for (size_t i = 0; i < ncalls; i++) {
+        lean_object *args_obj = lean_array_get_core(batch_obj, i);
+        for (size_t j = 0; j < nargs; j++)
+            frame.set(j, lean_array_get_core(args_obj, j));
+
+        invoke(frame);
+        lean_array_set_core(results, i, CValue::unmarshal(*m_rtype, frame.rvalue()));
+    }
+    return results;
+}
+
+/**
+ * Create a function with a prepared CIF.
+ *
+ * All arguments are borrowed. The pointer is referenced by the new object.
+ */
+extern "C" lean_obj_res ForeignFunction_mk(b_lean_obj_arg ptr_obj,
+                                           b_lean_obj_arg rtype_obj,
+                                           b_lean_obj_arg args_obj,
+                                           b_lean_obj_arg vargs_obj,
+                                           lean_object *unused) {
+    try {
+        auto fn = new ForeignFunction(ptr_obj, rtype_obj, args_obj, vargs_obj);
+        return lean_io_result_mk_ok(fn->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Create a function that is always called with libffi.
+ *
+ * This is only useful to compare it with direct calls.
+ */
+extern "C" lean_obj_res ForeignFunction_mkGeneric(b_lean_obj_arg ptr_obj,
+                                                  b_lean_obj_arg rtype_obj,
+                                                  b_lean_obj_arg args_obj,
+                                                  b_lean_obj_arg vargs_obj,
+                                                  lean_object *unused) {
+    try {
+        auto fn = new ForeignFunction(ptr_obj, rtype_obj, args_obj, vargs_obj, false);
+        return lean_io_result_mk_ok(fn->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Create a function for a symbol in a library.
+ *
+ * If the signature was listed in the binding manifest at build time, the function is
+ * called with the generated shim.
+ */
+extern "C" lean_obj_res ForeignFunction_bind(b_lean_obj_arg lib_obj,
+                                             b_lean_obj_arg name_obj,
+                                             b_lean_obj_arg rtype_obj,
+                                             b_lean_obj_arg args_obj,
+                                             lean_object *unused) {
+    const char *name = lean_string_cstr(name_obj);
+    lean_object *vargs_obj = lean_mk_empty_array();
+    lean_object *ptr_obj = nullptr;
+    try {
+        ptr_obj = Library::unbox(lib_obj)->symbol(name, lib_obj)->box();
+        auto fn = new ForeignFunction(ptr_obj, rtype_obj, args_obj, vargs_obj);
+        fn->bind(name);
+        lean_dec(ptr_obj);
+        lean_dec(vargs_obj);
+        return lean_io_result_mk_ok(fn->box());
+    } catch (const std::runtime_error &error) {
+        if (ptr_obj)
+            lean_dec(ptr_obj);
+        lean_dec(vargs_obj);
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Call the function with CValue arguments.
+ */
+extern "C" lean_obj_res ForeignFunction_call(b_lean_obj_arg fn_obj,
+                                             b_lean_obj_arg args_obj,
+                                             lean_object *unused) {
+    try {
+        return lean_io_result_mk_ok(ForeignFunction::unbox(fn_obj)->call(args_obj));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Call the function for every array of CValue arguments.
+ */
+extern "C" lean_obj_res ForeignFunction_callBatch(b_lean_obj_arg fn_obj,
+                                                  b_lean_obj_arg batch_obj,
+                                                  lean_object *unused) {
+    try {
+        auto fn = ForeignFunction::unbox(fn_obj);
+        return lean_io_result_mk_ok(fn->call_batch(batch_obj));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Get the function pointer. */
+extern "C" lean_obj_res ForeignFunction_pointer(b_lean_obj_arg fn_obj) {
+    lean_object *p = ForeignFunction::unbox(fn_obj)->pointer();
+    lean_inc(p);
+    return p;
+}
+
+/** Check if the function is called without libffi. */
+extern "C" uint8_t ForeignFunction_isDirect(b_lean_obj_arg fn_obj) {
+    return ForeignFunction::unbox(fn_obj)->is_direct();
+}
+
+/** Check if the function is called with a generated binding. */
+extern "C" uint8_t ForeignFunction_isGenerated(b_lean_obj_arg fn_obj) {
+    return ForeignFunction::unbox(fn_obj)->is_generated();
+}
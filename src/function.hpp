@@ -0,0 +1,93 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "bindings.hpp"
+#include "direct.hpp"
+#include "external_type.hpp"
+#include "frame.hpp"
+#include "pointer.hpp"
+#include "types.hpp"
+#include <ffi.h>
+#include <lean/lean.h>
+#include <memory>
+#include <vector>
+
+/**
+ * Function pointer with a prepared call interface.
+ *
+ * The return type, the argument types and the CIF are created once, so a call only
+ * has to convert the arguments and invoke ffi_call().
+ */
+class ForeignFunction final : public ExternalType<ForeignFunction> {
+  public:
+    ForeignFunction(b_lean_obj_arg pointer_obj, b_lean_obj_arg rtype_obj,
+                    b_lean_obj_arg args_obj, b_lean_obj_arg vargs_obj,
+                    bool direct = true);
+
+    ~ForeignFunction() { lean_dec(m_pointer_obj); }
+
+    /** Call the function with an array of fixed and variadic CValue arguments. */
+    lean_obj_res call(b_lean_obj_arg args_obj);
+
+    /**
+     * Call the function once for every array of arguments.
+     *
+     * All arguments are checked before the first call, and a single frame is reused
+     * for all calls.
+     */
+    lean_obj_res call_batch(b_lean_obj_arg batch_obj);
+
+    /**
+     * Use the generated binding of a symbol if it has the signature of the function.
+     *
+     * Only valid for non-variadic functions.
+     */
+    void bind(const char *symbol);
+
+    /** Check if the function is called without libffi. */
+    bool is_direct() const { return m_thunk != nullptr || m_binding != nullptr; }
+
+    /** Check if the function is called with a generated binding. */
+    bool is_generated() const { return m_binding != nullptr; }
+
+    /** Get the Lean object of the function pointer. */
+    lean_object *pointer() const { return m_pointer_obj; }
+
+    /** The function pointer is kept alive by the object. */
+    const std::vector<lean_object *> children() { return {m_pointer_obj}; }
+
+  private:
+    /** Check the number and the types of the arguments. */
+    void check_args(b_lean_obj_arg args_obj) const;
+
+    /** Call the function with the values in a frame. */
+    void invoke(CallFrame &frame);
+
+    // Pointer object of the function.
+    lean_object *m_pointer_obj;
+    // Return type and types of the fixed and variadic arguments.
+    const CType *m_rtype;
+    std::vector<const CType *> m_argtypes;
+    // Argument types passed to the CIF. They have to outlive it.
+    std::vector<ffi_type *> m_ffi_argtypes;
+    ffi_cif m_cif;
+    // Thunk for a direct call or nullptr if the function is called with libffi.
+    DirectThunk m_thunk;
+    // Generated binding or nullptr if the function is not bound.
+    const Binding *m_binding;
+};
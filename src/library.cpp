@@ -19,6 +19,7 @@
 #include <cstdlib>
 #include <cstring>
 #include <dlfcn.h>
+#include <link.h>
 #include <lean/lean.h>
 #include <stdexcept>
 
@@ -52,63 +53,143 @@ static inline int OptionFlag_unbox(b_lean_obj_arg flag) {
     lean_internal_panic_unreachable();
 }
 
+std::mutex LibraryHandle::s_mutex;
+std::map<LibraryHandle::Key, std::weak_ptr<LibraryHandle>> LibraryHandle::s_handles;
+
+/**
+ * Open a library or get the handle if it is already open.
+ *
+ * Handles are looked up by the path passed to dlopen() first. A different path to
+ * the same file is only detected after opening it, but the existing handle is still
+ * used in that case. Entries of closed handles are removed here rather than in the
+ * destructor, which may run while the lock is held.
+ */
+std::shared_ptr<LibraryHandle> LibraryHandle::open(const char *path, int flags) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    for (auto it = s_handles.begin(); it != s_handles.end();) {
+        if (it->second.expired())
+            it = s_handles.erase(it);
+        else
+            ++it;
+    }
+
+    auto lookup = [](const Key &key) -> std::shared_ptr<LibraryHandle> {
+        auto it = s_handles.find(key);
+        return it == s_handles.end() ? nullptr : it->second.lock();
+    };
+
+    Key key = {path, flags};
+    if (auto existing = lookup(key))
+        return existing;
+
+    void *handle = dlopen(path, flags);
+    if (handle == NULL)
+        throw std::runtime_error(std::string(dlerror()));
+
+    // Get the path of the file that was actually loaded.
+    std::string resolved = path;
+    struct link_map *map;
+    if (dlinfo(handle, RTLD_DI_LINKMAP, &map) == 0 && map->l_name[0] != '\0')
+        resolved = map->l_name;
+
+    Key resolved_key = {resolved, flags};
+    if (auto existing = lookup(resolved_key)) {
+        // Only decrease the reference count of the loader.
+        dlclose(handle);
+        s_handles[key] = existing;
+        return existing;
+    }
+
+    std::shared_ptr<LibraryHandle> result(new LibraryHandle(handle, resolved));
+    s_handles[key] = result;
+    s_handles[resolved_key] = result;
+    return result;
+}
+
 /**
  * Initialize the library object by opening the shared library with dlopen().
  *
  * Raises an exception with an error message on error.
  */
-Library::Library(b_lean_obj_arg path, b_lean_obj_arg mode, b_lean_obj_arg options)
-    : m_closed(false) {
+Library::Library(b_lean_obj_arg path, b_lean_obj_arg mode, b_lean_obj_arg options) {
     const char *p = lean_string_cstr(path);
-    uint64_t openflags = ModeFlag_unbox(mode);
+    int openflags = ModeFlag_unbox(mode);
     for (size_t i = 0; i < lean_array_size(options); i++) {
         lean_object *o = lean_array_get_core(options, i);
         openflags |= OptionFlag_unbox(o);
     }
-    void *handle = dlopen(p, openflags);
-    if (handle == NULL)
-        throw std::runtime_error(std::string(dlerror()));
-
+    m_handle = LibraryHandle::open(p, openflags);
     m_path = strdup(p);
-    m_handle = handle;
 }
 
 /**
  * Free the path.
  *
- * We don't close the handle here, because another symbol might still
- * depend on it even if the library is already out of scope.
- * Reference counting has to be handled by the user.
+ * The handle is closed once it isn't used by another library anymore. Pointers to
+ * symbols keep their library alive.
  */
 Library::~Library() { free(m_path); }
 
 /** Lookup a symbol in the library. */
-Pointer *Library::symbol(const char *name) {
-    if (m_closed)
+Pointer *Library::symbol(const char *name, b_lean_obj_arg owner) {
+    void *p;
+    if (!address(name, p))
+        throw std::runtime_error(std::string(m_path) + ": undefined symbol: " + name);
+    return new Pointer((uint8_t *)p, owner);
+}
+
+/** Create a pointer to a symbol that is looked up on first use. */
+Pointer *Library::lazy_symbol(const char *name, b_lean_obj_arg owner) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_handle)
+        throw std::runtime_error("library already closed");
+    if (name[0] == '\0')
+        throw std::runtime_error("empty symbol name");
+    return new Pointer(std::string(name), owner);
+}
+
+/** Get the address of a symbol. */
+bool Library::address(const char *name, void *&address) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_handle)
         throw std::runtime_error("library already closed");
 
+    if (auto it = m_symbols.find(name); it != m_symbols.end()) {
+        address = it->second;
+        return true;
+    }
+
     // Clear dlerror() to distinguish between errors and NULL.
     dlerror();
-    void *p = dlsym(m_handle, name);
-    if (p == nullptr) {
-        char *msg = dlerror();
-        if (msg != nullptr)
-            throw std::runtime_error(std::string(msg));
-    }
-    return new Pointer((uint8_t *)p);
+    address = dlsym(m_handle->handle(), name);
+    if (address == nullptr && dlerror() != nullptr)
+        return false;
+
+    m_symbols.emplace(name, address);
+    return true;
+}
+
+/** Get the index of the exported symbols. */
+std::shared_ptr<const SymbolIndex> Library::index() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_handle)
+        throw std::runtime_error("library already closed");
+
+    if (!m_index)
+        m_index = std::make_shared<const SymbolIndex>(m_handle->handle());
+    return m_index;
 }
 
 /** Close the library. */
 void Library::close() {
-    if (m_closed)
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_handle)
         throw std::runtime_error("library already closed");
 
-    m_closed = true;
-    int result = dlclose(m_handle);
-    if (result != 0) {
-        char *msg = dlerror();
-        throw std::runtime_error(std::string(msg));
-    }
+    // The handle is only closed if no other library uses it.
+    m_handle.reset();
+    m_symbols.clear();
+    m_index.reset();
 }
 
 /**
@@ -154,7 +235,23 @@ extern "C" lean_obj_res Library_symbol(b_lean_obj_arg lib, b_lean_obj_arg name,
                                        lean_object *unused) {
 
     try {
-        Pointer *p = Library::unbox(lib)->symbol(lean_string_cstr(name));
+        Pointer *p = Library::unbox(lib)->symbol(lean_string_cstr(name), lib);
+        return lean_io_result_mk_ok(p->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Create a pointer to a symbol that is looked up on first use.
+ *
+ * The library is owned by the pointer. All other arguments are borrowed.
+ */
+extern "C" lean_obj_res Library_lazySymbol(b_lean_obj_arg lib, b_lean_obj_arg name,
+                                           lean_object *unused) {
+    try {
+        Pointer *p = Library::unbox(lib)->lazy_symbol(lean_string_cstr(name), lib);
         return lean_io_result_mk_ok(p->box());
     } catch (const std::runtime_error &error) {
         lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
@@ -172,3 +269,99 @@ extern "C" lean_obj_res Library_close(b_lean_obj_arg lib, lean_object *unused) {
         return lean_io_result_mk_error(err);
     }
 }
+
+/**
+ * Lookup several symbols at once.
+ *
+ * Symbols that don't exist are returned as `none`.
+ */
+extern "C" lean_obj_res Library_symbols(b_lean_obj_arg lib_obj, b_lean_obj_arg names,
+                                        lean_object *unused) {
+    auto lib = Library::unbox(lib_obj);
+    size_t n = lean_array_size(names);
+    lean_object *result = lean_alloc_array(n, n);
+
+    // Fill the array first, so it can be released on error.
+    for (size_t i = 0; i < n; i++)
+        lean_array_set_core(result, i, lean_box(0));
+
+    try {
+        for (size_t i = 0; i < n; i++) {
+            void *address;
+            const char *name = lean_string_cstr(lean_array_get_core(names, i));
+            if (!lib->address(name, address))
+                continue;
+
+            lean_object *some = lean_alloc_ctor(1, 1, 0);
+            lean_ctor_set(some, 0, (new Pointer((uint8_t *)address, lib_obj))->box());
+            lean_array_set_core(result, i, some);
+        }
+        return lean_io_result_mk_ok(result);
+    } catch (const std::runtime_error &error) {
+        lean_dec(result);
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Create a Lean array of strings. */
+static lean_obj_res mk_string_array(const std::vector<std::string> &strings) {
+    lean_object *result = lean_alloc_array(strings.size(), strings.size());
+    for (size_t i = 0; i < strings.size(); i++)
+        lean_array_set_core(result, i, lean_mk_string(strings[i].c_str()));
+    return lean_io_result_mk_ok(result);
+}
+
+/** Get the names of all exported symbols. */
+extern "C" lean_obj_res Library_exports(b_lean_obj_arg lib, lean_object *unused) {
+    try {
+        return mk_string_array(Library::unbox(lib)->index()->names());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Get the names of the exported symbols that start with a prefix. */
+extern "C" lean_obj_res Library_exportsWithPrefix(b_lean_obj_arg lib,
+                                                  b_lean_obj_arg prefix,
+                                                  lean_object *unused) {
+    try {
+        auto index = Library::unbox(lib)->index();
+        return mk_string_array(index->with_prefix(lean_string_cstr(prefix)));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Get the names of the exported symbols that match a glob pattern. */
+extern "C" lean_obj_res Library_exportsMatching(b_lean_obj_arg lib,
+                                                b_lean_obj_arg pattern,
+                                                lean_object *unused) {
+    try {
+        auto index = Library::unbox(lib)->index();
+        return mk_string_array(index->matching(lean_string_cstr(pattern)));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Check which of the names are exported. */
+extern "C" lean_obj_res Library_hasExports(b_lean_obj_arg lib, b_lean_obj_arg names,
+                                           lean_object *unused) {
+    try {
+        auto index = Library::unbox(lib)->index();
+        size_t n = lean_array_size(names);
+        lean_object *result = lean_alloc_array(n, n);
+        for (size_t i = 0; i < n; i++) {
+            const char *name = lean_string_cstr(lean_array_get_core(names, i));
+            lean_array_set_core(result, i, lean_box(index->contains(name)));
+        }
+        return lean_io_result_mk_ok(result);
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
@@ -18,7 +18,51 @@
 
 #include "external_type.hpp"
 #include "pointer.hpp"
+#include "symbol_index.hpp"
+#include <dlfcn.h>
 #include <lean/lean.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/**
+ * Handle returned by dlopen().
+ *
+ * Handles are shared by all libraries that open the same file with the same flags,
+ * so dlopen() is called only once. The handle is closed with dlclose() when the last
+ * library that uses it is finalized.
+ */
+class LibraryHandle {
+  public:
+    LibraryHandle(const LibraryHandle &) = delete;
+    LibraryHandle &operator=(const LibraryHandle &) = delete;
+
+    ~LibraryHandle() { dlclose(m_handle); }
+
+    /** Open a library or get the handle if it is already open. */
+    static std::shared_ptr<LibraryHandle> open(const char *path, int flags);
+
+    /** Get the handle returned by dlopen(). */
+    void *handle() const { return m_handle; }
+
+    /** Get the path of the file. */
+    const std::string &path() const { return m_path; }
+
+  private:
+    LibraryHandle(void *handle, const std::string &path)
+        : m_handle(handle), m_path(path) {}
+
+    // Open handles by the path, as passed to dlopen() and resolved, and the flags.
+    using Key = std::pair<std::string, int>;
+    static std::mutex s_mutex;
+    static std::map<Key, std::weak_ptr<LibraryHandle>> s_handles;
+
+    void *m_handle;
+    std::string m_path;
+};
 
 class Library final : public ExternalType<Library> {
   public:
@@ -29,10 +73,36 @@ class Library final : public ExternalType<Library> {
     const char *path() { return m_path; }
 
     /** Get the handle of the library. */
-    void *handle() { return m_handle; }
+    void *handle() { return m_handle ? m_handle->handle() : nullptr; }
 
-    /** Lookup a symbol in the library. */
-    Pointer *symbol(const char *name);
+    /**
+     * Lookup a symbol in the library.
+     *
+     * The pointer keeps `owner`, the Lean object of the library, alive.
+     */
+    Pointer *symbol(const char *name, b_lean_obj_arg owner);
+
+    /**
+     * Create a pointer to a symbol without looking it up.
+     *
+     * dlsym() is only called when the pointer is used for the first time.
+     */
+    Pointer *lazy_symbol(const char *name, b_lean_obj_arg owner);
+
+    /**
+     * Get the address of a symbol.
+     *
+     * Addresses are cached, so dlsym() is only called once for each name. Returns
+     * false if the symbol doesn't exist.
+     */
+    bool address(const char *name, void *&address);
+
+    /**
+     * Get the index of the exported symbols.
+     *
+     * The index is created when it is used for the first time.
+     */
+    std::shared_ptr<const SymbolIndex> index();
 
     /** Close the library. */
     void close();
@@ -43,8 +113,11 @@ class Library final : public ExternalType<Library> {
   private:
     // Path of the library for debugging.
     char *m_path;
-    // Handle returned by dlopen().
-    void *m_handle;
-    // Check if already closed.
-    bool m_closed;
+    // Shared handle, or nullptr if the library was closed.
+    std::shared_ptr<LibraryHandle> m_handle;
+    // Addresses of symbols that were already looked up.
+    std::mutex m_mutex;
+    std::unordered_map<std::string, void *> m_symbols;
+    // Exported symbols, or nullptr if they weren't needed yet.
+    std::shared_ptr<const SymbolIndex> m_index;
 };
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mapped.hpp"
+#include "pointer.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Create an exception with the message of errno. */
+static std::runtime_error errno_error(const std::string &what) {
+    return std::runtime_error(what + ": " + strerror(errno));
+}
+
+/** Map a part of a file. */
+MappedRegion::MappedRegion(const char *path, Mode mode, size_t offset, size_t length)
+    : m_base(nullptr), m_length(0), m_data(nullptr), m_size(0) {
+
+    int fd = open(path, mode == SHARED ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+        throw errno_error(path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int err = errno;
+        ::close(fd);
+        errno = err;
+        throw errno_error(path);
+    }
+
+    size_t filesize = st.st_size;
+    if (offset > filesize || (length != 0 && length > filesize - offset)) {
+        ::close(fd);
+        throw std::runtime_error(std::string(path) + ": region out of range");
+    }
+    m_size = length == 0 ? filesize - offset : length;
+
+    // Empty regions can't be mapped, but they are still valid.
+    if (m_size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    // The offset passed to mmap() has to be aligned to pages.
+    size_t pagesize = sysconf(_SC_PAGESIZE);
+    size_t aligned = offset - offset % pagesize;
+    m_length = m_size + (offset - aligned);
+
+    int prot = mode == READ_ONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+    int flags = mode == SHARED ? MAP_SHARED : MAP_PRIVATE;
+    void *base = mmap(nullptr, m_length, prot, flags, fd, aligned);
+    int err = errno;
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        errno = err;
+        throw errno_error(path);
+    }
+
+    m_base = (uint8_t *)base;
+    m_data = m_base + (offset - aligned);
+}
+
+/** Unmap the region. */
+MappedRegion::~MappedRegion() {
+    if (m_base)
+        munmap(m_base, m_length);
+}
+
+/** Give a hint about the access pattern. */
+void MappedRegion::advise(int advice) {
+    if (m_base && madvise(m_base, m_length, advice) != 0)
+        throw errno_error("madvise()");
+}
+
+/** Write changes back to the file. */
+void MappedRegion::sync() {
+    if (m_base && msync(m_base, m_length, MS_SYNC) != 0)
+        throw errno_error("msync()");
+}
+
+/**
+ * Convert the Advice enum.
+ *
+ * Enums without fields are passed as `uint8_t`, not as boxed scalars.
+ */
+static inline int Advice_convert(uint8_t advice) {
+    switch (advice) {
+    case 0:
+        return MADV_NORMAL;
+    case 1:
+        return MADV_SEQUENTIAL;
+    case 2:
+        return MADV_RANDOM;
+    case 3:
+        return MADV_WILLNEED;
+    case 4:
+        return MADV_DONTNEED;
+    case 5:
+#ifdef MADV_HUGEPAGE
+        return MADV_HUGEPAGE;
+#else
+        // Only a hint, so it is ignored if it isn't supported.
+        return MADV_NORMAL;
+#endif
+    }
+    lean_internal_panic_unreachable();
+}
+
+/**
+ * Map a part of a file.
+ *
+ * All arguments are borrowed. A length of 0 maps the rest of the file.
+ */
+extern "C" lean_obj_res MappedRegion_mk(b_lean_obj_arg path_obj, uint8_t mode_value,
+                                        b_lean_obj_arg offset_obj,
+                                        b_lean_obj_arg length_obj,
+                                        lean_object *unused) {
+    try {
+        if (mode_value > MappedRegion::SHARED)
+            throw std::runtime_error("invalid mapping mode");
+        auto mode = (MappedRegion::Mode)mode_value;
+        size_t offset = lean_usize_of_nat(offset_obj);
+        size_t length = lean_usize_of_nat(length_obj);
+        const char *path = lean_string_cstr(path_obj);
+        auto region = new MappedRegion(path, mode, offset, length);
+        return lean_io_result_mk_ok(region->box());
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Get a pointer to the start of the region.
+ *
+ * The pointer keeps the region mapped.
+ */
+extern "C" lean_obj_res MappedRegion_pointer(b_lean_obj_arg region_obj) {
+    auto region = MappedRegion::unbox(region_obj);
+    return (new Pointer(region->data(), region_obj))->box();
+}
+
+/** Get the size of the region. */
+extern "C" lean_obj_res MappedRegion_size(b_lean_obj_arg region_obj) {
+    return lean_usize_to_nat(MappedRegion::unbox(region_obj)->size());
+}
+
+/** Give a hint about the access pattern. */
+extern "C" lean_obj_res MappedRegion_advise(b_lean_obj_arg region_obj,
+                                            uint8_t advice, lean_object *unused) {
+    try {
+        MappedRegion::unbox(region_obj)->advise(Advice_convert(advice));
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/** Write changes of a shared region back to the file. */
+extern "C" lean_obj_res MappedRegion_sync(b_lean_obj_arg region_obj,
+                                          lean_object *unused) {
+    try {
+        MappedRegion::unbox(region_obj)->sync();
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "external_type.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <lean/lean.h>
+#include <vector>
+
+/**
+ * File region mapped into memory with mmap().
+ *
+ * The region is unmapped when the object is finalized. The pointer of the region
+ * and pointers derived from it by offsets keep the Lean object alive.
+ */
+class MappedRegion final : public ExternalType<MappedRegion> {
+  public:
+    /** How the file is mapped. Keep in sync with MappedRegion.Mode. */
+    enum Mode { READ_ONLY, COPY_ON_WRITE, SHARED };
+
+    /**
+     * Map `length` bytes of a file, starting at `offset`.
+     *
+     * The offset doesn't have to be aligned to pages. If `length` is 0, the rest of
+     * the file is mapped. Raises an exception on error.
+     */
+    MappedRegion(const char *path, Mode mode, size_t offset, size_t length);
+
+    ~MappedRegion();
+
+    MappedRegion(const MappedRegion &) = delete;
+    MappedRegion &operator=(const MappedRegion &) = delete;
+
+    /** Get the address of the first byte at the requested offset. */
+    uint8_t *data() const { return m_data; }
+
+    /** Get the number of bytes at the requested offset. */
+    size_t size() const { return m_size; }
+
+    /** Give a hint about the access pattern to madvise(). */
+    void advise(int advice);
+
+    /** Write changes of a shared mapping back to the file with msync(). */
+    void sync();
+
+    /** No children. */
+    const std::vector<lean_object *> children() { return {}; }
+
+  private:
+    // Address and length of the whole mapping, which starts at a page boundary.
+    uint8_t *m_base;
+    size_t m_length;
+    // Requested part of the mapping.
+    uint8_t *m_data;
+    size_t m_size;
+};
@@ -15,66 +15,283 @@
  */
 
 #include "pointer.hpp"
+#include "arena.hpp"
+#include "convert.hpp"
+#include "direct.hpp"
+#include "frame.hpp"
 #include "lean/lean.h"
+#include "library.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 #include <algorithm>
 #include <complex>
 #include <cstdint>
+#include <cstring>
 #include <stdexcept>
 
-/** Call the pointer as a function. */
-std::unique_ptr<CValue> Pointer::call(CType &rtype,
-                                      std::vector<std::unique_ptr<CValue>> &args,
-                                      std::vector<std::unique_ptr<CValue>> &vargs) {
+/**
+ * Look up a lazy symbol in the library.
+ *
+ * Concurrent first uses may both call this, but the library caches the address, so
+ * they store the same value.
+ */
+uint8_t *Pointer::resolve() const {
+    void *address;
+    auto lib = Library::unbox(m_owner);
+    if (!lib->address(m_symbol.c_str(), address))
+        throw std::runtime_error(std::string(lib->path()) +
+                                 ": undefined symbol: " + m_symbol);
+    auto pointer = (uint8_t *)((uintptr_t)address + m_delta);
+    m_pointer.store(pointer, std::memory_order_release);
+    return pointer;
+}
 
-    // Type buffer and vector for cleanup.
-    std::vector<std::unique_ptr<CType>> types;
-    ffi_type *argtypes[args.size() + vargs.size()];
+/**
+ * Create a pointer at an offset with the same owner.
+ */
+Pointer *Pointer::offset(size_t delta) const {
+    uint8_t *base = m_pointer.load(std::memory_order_acquire);
+    if (base == nullptr && !m_symbol.empty())
+        return new Pointer(m_symbol, m_owner, m_delta + delta);
 
-    // Value buffer and vector for cleanup.
-    std::vector<std::unique_ptr<uint8_t[]>> argbufs;
-    void *argvals[args.size() + vargs.size()];
+    auto address = (uint8_t *)((uintptr_t)base + delta);
+    if (m_owner)
+        return new Pointer(address, m_owner);
+    return new Pointer(address);
+}
 
-    for (size_t i = 0; i < args.size(); i++) {
-        auto tp = args[i]->type();
-        argtypes[i] = tp->ffitype();
-        types.push_back(std::move(tp));
+/**
+ * Call the pointer as a function.
+ *
+ * The types of the arguments are resolved first, because the CIF needs them.
+ * The values are then written directly to a single frame.
+ */
+lean_obj_res Pointer::call(const CType &rtype, b_lean_obj_arg args,
+                           b_lean_obj_arg vargs) {
+    size_t nfixed = lean_array_size(args);
+    size_t nargs = nfixed + lean_array_size(vargs);
+    auto arg = [&](size_t i) {
+        return i < nfixed ? lean_array_get_core(args, i)
+                          : lean_array_get_core(vargs, i - nfixed);
+    };
 
-        auto buf = args[i]->to_buffer();
-        argvals[i] = buf.get();
-        argbufs.push_back(std::move(buf));
-    }
-    for (size_t i = 0; i < vargs.size(); i++) {
-        auto tp = vargs[i]->type();
-        argtypes[args.size() + i] = tp->ffitype();
-        types.push_back(std::move(tp));
+    // The types are interned, so only the array is allocated in the arena.
+    FrameArena::Scope scope;
+    auto types = FrameArena::local().alloc_array<const CType *>(nargs);
+    for (size_t i = 0; i < nargs; i++)
+        types[i] = CValue::type_of(arg(i));
 
-        auto buf = vargs[i]->to_buffer();
-        argvals[args.size() + i] = buf.get();
-        argbufs.push_back(std::move(buf));
+    // Marshal the arguments and call the function.
+    CallFrame frame(rtype, types, nargs);
+    for (size_t i = 0; i < nargs; i++)
+        frame.set(i, arg(i));
+    call(rtype, types, nfixed, nargs, frame);
+
+    return CValue::unmarshal(rtype, frame.rvalue());
+}
+
+/**
+ * Call the pointer with the values in a frame.
+ *
+ * Simple signatures are called directly, everything else with a CIF that is only
+ * prepared for this call.
+ */
+void Pointer::call(const CType &rtype, const CType *const *types, size_t nfixed,
+                   size_t nargs, CallFrame &frame) const {
+    DirectThunk thunk = nargs == nfixed ? direct_thunk(rtype, types, nargs) : nullptr;
+    if (thunk) {
+        call(thunk, frame.rvalue(), frame.argvals(), types);
+        return;
     }
 
-    // Prepare the CIF.
+    FrameArena::Scope scope;
+    auto argtypes = FrameArena::local().alloc_array<ffi_type *>(nargs);
+    for (size_t i = 0; i < nargs; i++)
+        argtypes[i] = types[i]->ffitype();
+
     ffi_cif cif;
-    if (vargs.size() == 0) {
+    if (nargs == nfixed) {
         ffi_status status =
-            ffi_prep_cif(&cif, FFI_DEFAULT_ABI, args.size(), rtype.ffitype(), argtypes);
+            ffi_prep_cif(&cif, FFI_DEFAULT_ABI, nargs, rtype.ffitype(), argtypes);
         if (status != FFI_OK)
             throw std::runtime_error("ffi_prep_cif() failed");
     } else {
-        ffi_status status =
-            ffi_prep_cif_var(&cif, FFI_DEFAULT_ABI, args.size(),
-                             args.size() + vargs.size(), rtype.ffitype(), argtypes);
+        ffi_status status = ffi_prep_cif_var(&cif, FFI_DEFAULT_ABI, nfixed, nargs,
+                                             rtype.ffitype(), argtypes);
         if (status != FFI_OK)
             throw std::runtime_error("ffi_prep_cif_var() failed");
     }
+    call(&cif, frame.rvalue(), frame.argvals());
+}
+
+/** Constructors of the Argument inductive. Keep them in sync. */
+enum ArgumentTag { ARG_VALUE, ARG_BYTES, ARG_FLOATS, ARG_STRING };
+
+/**
+ * Make a buffer argument and its array exclusive.
+ *
+ * The array has to be exclusive already. The buffer is only copied if another
+ * object still references it. Returns the exclusive buffer.
+ */
+static lean_object *make_exclusive(lean_object *args, size_t i) {
+    lean_object *arg = lean_array_get_core(args, i);
+    unsigned tag = lean_ptr_tag(arg);
+    lean_object *buffer = lean_ctor_get(arg, 0);
+
+    if (lean_is_exclusive(arg)) {
+        // Take the buffer out of the argument.
+        lean_ctor_set(arg, 0, lean_box(0));
+    } else {
+        lean_inc(buffer);
+        lean_dec(arg);
+        arg = lean_alloc_ctor(tag, 1, 0);
+        lean_array_set_core(args, i, arg);
+    }
+
+    if (!lean_is_exclusive(buffer)) {
+        buffer = tag == ARG_BYTES ? lean_copy_byte_array(buffer)
+                                  : lean_copy_float_array(buffer);
+    }
+    lean_ctor_set(arg, 0, buffer);
+    return buffer;
+}
+
+/**
+ * Call the pointer with Argument objects.
+ *
+ * The arguments are returned together with the result, because buffers might have
+ * been copied to make them exclusive.
+ */
+lean_obj_res Pointer::call_with(const CType &rtype, lean_obj_arg args) {
+    if (!lean_is_exclusive(args))
+        args = lean_copy_expand_array(args, false);
+
+    try {
+        size_t nargs = lean_array_size(args);
+        FrameArena::Scope scope;
+        auto types = FrameArena::local().alloc_array<const CType *>(nargs);
+        for (size_t i = 0; i < nargs; i++) {
+            lean_object *arg = lean_array_get_core(args, i);
+            if (lean_ptr_tag(arg) == ARG_VALUE)
+                types[i] = CValue::type_of(lean_ctor_get(arg, 0));
+            else
+                types[i] = CType::primitive(POINTER);
+        }
+
+        CallFrame frame(rtype, types, nargs);
+        for (size_t i = 0; i < nargs; i++) {
+            lean_object *arg = lean_array_get_core(args, i);
+            switch (lean_ptr_tag(arg)) {
+            case ARG_VALUE:
+                frame.set(i, lean_ctor_get(arg, 0));
+                break;
+            case ARG_BYTES:
+                frame.set_pointer(i, lean_sarray_cptr(make_exclusive(args, i)));
+                break;
+            case ARG_FLOATS:
+                frame.set_pointer(i, lean_float_array_cptr(make_exclusive(args, i)));
+                break;
+            case ARG_STRING:
+                // Strings are read-only, so they don't have to be exclusive.
+                frame.set_pointer(i, (void *)lean_string_cstr(lean_ctor_get(arg, 0)));
+                break;
+            }
+        }
+        call(rtype, types, nargs, nargs, frame);
+
+        lean_object *result = lean_alloc_ctor(0, 2, 0);
+        lean_ctor_set(result, 0, CValue::unmarshal(rtype, frame.rvalue()));
+        lean_ctor_set(result, 1, args);
+        return result;
+    } catch (const std::runtime_error &error) {
+        lean_dec(args);
+        throw;
+    }
+}
+
+/** Call the pointer for every element of an array. */
+void Pointer::map_call(const CType &rtype, const CType &argtype, const uint8_t *src,
+                       uint8_t *dst, size_t count) const {
+    const CType *types[] = {&argtype};
+    DirectThunk thunk = direct_thunk(rtype, types, 1);
+
+    ffi_cif cif;
+    ffi_type *argtypes[] = {argtype.ffitype()};
+    if (!thunk) {
+        ffi_status status =
+            ffi_prep_cif(&cif, FFI_DEFAULT_ABI, 1, rtype.ffitype(), argtypes);
+        if (status != FFI_OK)
+            throw std::runtime_error("ffi_prep_cif() failed");
+    }
+
+    FrameArena::Scope scope;
+    size_t rsize = std::max(sizeof(ffi_arg), rtype.size());
+    uint8_t *rvalue = FrameArena::local().alloc(rsize);
+
+    // The function is called directly on the elements in the source array.
+    size_t insize = argtype.size();
+    size_t outsize = rtype.tag() == VOID ? 0 : rtype.size();
+    for (size_t i = 0; i < count; i++) {
+        void *argvals[] = {(void *)(src + i * insize)};
+        if (thunk)
+            call(thunk, rvalue, argvals, types);
+        else
+            call(&cif, rvalue, argvals);
+        memcpy(dst + i * outsize, rvalue, outsize);
+    }
+}
+
+/**
+ * Read an array of values.
+ *
+ * The type and the address are resolved once for all elements.
+ */
+lean_obj_res Pointer::read_array(const CType &type, size_t count, size_t stride) {
+    uint8_t *base = pointer();
+    lean_object *result = lean_alloc_array(count, count);
+    for (size_t i = 0; i < count; i++)
+        lean_array_set_core(result, i, CValue::unmarshal(type, base + i * stride));
+    return result;
+}
+
+/** Write an array of values. */
+void Pointer::write_array(const CType &type, b_lean_obj_arg values, size_t stride) {
+    size_t count = lean_array_size(values);
+    for (size_t i = 0; i < count; i++) {
+        if (!CValue::matches(type, lean_array_get_core(values, i)))
+            throw std::runtime_error("value type mismatch");
+    }
 
-    // Call the function.
-    uint8_t rvalue[std::max(sizeof(ffi_arg), rtype.size())];
-    ffi_call(&cif, (void (*)())m_pointer, rvalue, argvals);
+    uint8_t *base = pointer();
+    for (size_t i = 0; i < count; i++)
+        CValue::marshal(type, lean_array_get_core(values, i), base + i * stride);
+}
+
+/** Copy bytes to a new ByteArray. */
+lean_obj_res Pointer::read_bytes(size_t count) {
+    uint8_t *src = pointer();
+    lean_object *bytes = lean_alloc_sarray(1, count, count);
+    memcpy(lean_sarray_cptr(bytes), src, count);
+    return bytes;
+}
+
+/** Convert values to a new FloatArray. */
+lean_obj_res Pointer::read_floats(const CType &type, size_t count) {
+    uint8_t *src = pointer();
+    lean_object *floats = lean_alloc_sarray(sizeof(double), count, count);
+    try {
+        convert_to_double(type, src, lean_float_array_cptr(floats), count);
+    } catch (const std::runtime_error &error) {
+        lean_dec(floats);
+        throw;
+    }
+    return floats;
+}
 
-    return CValue::from_buffer(rtype, rvalue);
+/** Convert the values of a FloatArray to a scalar type. */
+void Pointer::write_floats(const CType &type, b_lean_obj_arg floats) {
+    size_t count = lean_sarray_size(floats);
+    convert_from_double(type, lean_float_array_cptr(floats), pointer(), count);
 }
 
 /**
@@ -86,7 +303,7 @@ extern "C" lean_obj_res Pointer_read(b_lean_obj_arg ptr, b_lean_obj_arg type,
     auto ct = CType::unbox(type);
 
     try {
-        return lean_io_result_mk_ok(p->read(*ct)->box());
+        return lean_io_result_mk_ok(p->read(*ct));
     } catch (const std::runtime_error &error) {
         lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
         return lean_io_result_mk_error(err);
@@ -100,7 +317,110 @@ extern "C" lean_obj_res Pointer_write(b_lean_obj_arg ptr, b_lean_obj_arg value,
                                       lean_object *unused) {
     auto p = Pointer::unbox(ptr);
     try {
-        p->write(*CValue::unbox(value));
+        p->write(value);
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Read an array of values with a stride.
+ */
+extern "C" lean_obj_res Pointer_readArray(b_lean_obj_arg ptr, b_lean_obj_arg type,
+                                          b_lean_obj_arg count_obj,
+                                          b_lean_obj_arg stride_obj,
+                                          lean_object *unused) {
+    auto p = Pointer::unbox(ptr);
+    auto ct = CType::unbox(type);
+
+    try {
+        size_t count = lean_usize_of_nat(count_obj);
+        size_t stride = lean_usize_of_nat(stride_obj);
+        return lean_io_result_mk_ok(p->read_array(*ct, count, stride));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Write an array of values with a stride.
+ */
+extern "C" lean_obj_res Pointer_writeArray(b_lean_obj_arg ptr, b_lean_obj_arg type,
+                                           b_lean_obj_arg values,
+                                           b_lean_obj_arg stride_obj,
+                                           lean_object *unused) {
+    auto p = Pointer::unbox(ptr);
+    auto ct = CType::unbox(type);
+
+    try {
+        p->write_array(*ct, values, lean_usize_of_nat(stride_obj));
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Copy memory to a ByteArray.
+ */
+extern "C" lean_obj_res Pointer_readBytes(b_lean_obj_arg ptr, b_lean_obj_arg count_obj,
+                                          lean_object *unused) {
+    try {
+        size_t count = lean_usize_of_nat(count_obj);
+        return lean_io_result_mk_ok(Pointer::unbox(ptr)->read_bytes(count));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Copy a ByteArray to memory.
+ */
+extern "C" lean_obj_res Pointer_writeBytes(b_lean_obj_arg ptr, b_lean_obj_arg bytes,
+                                           lean_object *unused) {
+    try {
+        Pointer::unbox(ptr)->write_bytes(bytes);
+        return lean_io_result_mk_ok(lean_box(0));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Convert an array of numbers in memory to a FloatArray.
+ */
+extern "C" lean_obj_res Pointer_readFloats(b_lean_obj_arg ptr, b_lean_obj_arg type,
+                                           b_lean_obj_arg count_obj,
+                                           lean_object *unused) {
+    auto p = Pointer::unbox(ptr);
+    auto ct = CType::unbox(type);
+
+    try {
+        size_t count = lean_usize_of_nat(count_obj);
+        return lean_io_result_mk_ok(p->read_floats(*ct, count));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Convert a FloatArray to an array of numbers in memory.
+ */
+extern "C" lean_obj_res Pointer_writeFloats(b_lean_obj_arg ptr, b_lean_obj_arg type,
+                                            b_lean_obj_arg floats,
+                                            lean_object *unused) {
+    auto p = Pointer::unbox(ptr);
+    auto ct = CType::unbox(type);
+
+    try {
+        p->write_floats(*ct, floats);
         return lean_io_result_mk_ok(lean_box(0));
     } catch (const std::runtime_error &error) {
         lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
@@ -117,9 +437,40 @@ extern "C" lean_obj_res Pointer_mk(size_t value) {
 
 /**
  * Get the address of a pointer.
+ *
+ * Lazy symbols are not looked up, their address is 0 until they are resolved.
  */
 extern "C" size_t Pointer_address(b_lean_obj_arg obj) {
-    return (size_t)Pointer::unbox(obj)->pointer();
+    return (size_t)Pointer::unbox(obj)->address();
+}
+
+/**
+ * Look up a lazy symbol and get the address of a pointer.
+ */
+extern "C" lean_obj_res Pointer_resolve(b_lean_obj_arg obj, lean_object *unused) {
+    try {
+        auto address = (size_t)Pointer::unbox(obj)->pointer();
+        return lean_io_result_mk_ok(lean_box_usize(address));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
+    }
+}
+
+/**
+ * Add an offset to a pointer.
+ *
+ * The new pointer keeps the owner of the original one alive.
+ */
+extern "C" lean_obj_res Pointer_offset(b_lean_obj_arg obj, size_t delta) {
+    return Pointer::unbox(obj)->offset(delta)->box();
+}
+
+/**
+ * Check if the address of a pointer is known.
+ */
+extern "C" lean_obj_res Pointer_isResolved(b_lean_obj_arg obj, lean_object *unused) {
+    return lean_io_result_mk_ok(lean_box(Pointer::unbox(obj)->resolved()));
 }
 
 /**
@@ -132,23 +483,51 @@ extern "C" lean_obj_res Pointer_call(b_lean_obj_arg ptr_obj, b_lean_obj_arg rtyp
     auto ptr = Pointer::unbox(ptr_obj);
     auto rtype = CType::unbox(rtype_obj);
 
-    // Regular arguments
-    std::vector<std::unique_ptr<CValue>> args;
-    for (size_t i = 0; i < lean_array_size(args_obj); i++) {
-        lean_object *o = lean_array_get_core(args_obj, i);
-        args.push_back(CValue::unbox(o));
+    try {
+        return lean_io_result_mk_ok(ptr->call(*rtype, args_obj, vargs_obj));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
     }
+}
+
+/**
+ * Call a pointer with Argument objects.
+ *
+ * The arguments are owned and returned in the result.
+ */
+extern "C" lean_obj_res Pointer_callWith(b_lean_obj_arg ptr_obj,
+                                         b_lean_obj_arg rtype_obj,
+                                         lean_obj_arg args_obj, lean_object *unused) {
+    auto ptr = Pointer::unbox(ptr_obj);
+    auto rtype = CType::unbox(rtype_obj);
 
-    // Variadic arguments
-    std::vector<std::unique_ptr<CValue>> vargs;
-    for (size_t i = 0; i < lean_array_size(vargs_obj); i++) {
-        lean_object *o = lean_array_get_core(vargs_obj, i);
-        vargs.push_back(CValue::unbox(o));
+    try {
+        return lean_io_result_mk_ok(ptr->call_with(*rtype, args_obj));
+    } catch (const std::runtime_error &error) {
+        lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
+        return lean_io_result_mk_error(err);
     }
+}
+
+/**
+ * Call a function for every element of an array.
+ */
+extern "C" lean_obj_res Pointer_mapCall(b_lean_obj_arg fn_obj, b_lean_obj_arg src_obj,
+                                        b_lean_obj_arg dst_obj,
+                                        b_lean_obj_arg count_obj,
+                                        b_lean_obj_arg elem_obj,
+                                        b_lean_obj_arg result_obj,
+                                        lean_object *unused) {
+    auto fn = Pointer::unbox(fn_obj);
+    size_t count = lean_usize_of_nat(count_obj);
 
     try {
-        auto result = ptr->call(*rtype, args, vargs);
-        return lean_io_result_mk_ok(result->box());
+        auto src = Pointer::unbox(src_obj)->pointer();
+        auto dst = Pointer::unbox(dst_obj)->pointer();
+        auto &rtype = *CType::unbox(result_obj);
+        fn->map_call(rtype, *CType::unbox(elem_obj), src, dst, count);
+        return lean_io_result_mk_ok(lean_box(0));
     } catch (const std::runtime_error &error) {
         lean_object *err = lean_mk_io_user_error(lean_mk_string(error.what()));
         return lean_io_result_mk_error(err);
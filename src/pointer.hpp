@@ -16,45 +16,176 @@
 
 #pragma once
 
+#include "direct.hpp"
 #include "external_type.hpp"
+#include "thread.hpp"
 #include "types.hpp"
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
 #include <ffi.h>
 #include <lean/lean.h>
 #include <memory>
+#include <string>
 #include <vector>
 
+class CallFrame;
+
 /** A pointer in C. */
 class Pointer final : public ExternalType<Pointer> {
   public:
-    Pointer(uint8_t *pointer) : m_pointer(pointer) {}
+    Pointer(uint8_t *pointer) : m_pointer(pointer), m_owner(nullptr) {}
+
+    /**
+     * Create a pointer into memory that is kept alive by another Lean object.
+     *
+     * The pointer holds a reference to the owner until it is finalized.
+     */
+    Pointer(uint8_t *pointer, b_lean_obj_arg owner)
+        : m_pointer(pointer), m_owner(owner) {
+        lean_inc(m_owner);
+    }
+
+    /**
+     * Create a pointer `delta` bytes after a symbol that is looked up on first use.
+     *
+     * The pointer holds a reference to the library until it is finalized.
+     */
+    Pointer(const std::string &symbol, b_lean_obj_arg library, size_t delta = 0)
+        : m_pointer(nullptr), m_owner(library), m_symbol(symbol), m_delta(delta) {
+        lean_inc(m_owner);
+    }
+
+    ~Pointer() {
+        if (m_owner)
+            lean_dec(m_owner);
+    }
+
+    /** Read a CType from the memory, creating a Lean CValue object. */
+    lean_obj_res read(const CType &type) { return CValue::unmarshal(type, pointer()); }
+
+    /** Write a Lean CValue object to the memory location. */
+    void write(b_lean_obj_arg value) {
+        CValue::marshal(*CValue::type_of(value), value, pointer());
+    }
+
+    /**
+     * Read `count` values of a type that are `stride` bytes apart.
+     *
+     * Returns a Lean array of CValue objects.
+     */
+    lean_obj_res read_array(const CType &type, size_t count, size_t stride);
+
+    /**
+     * Write an array of Lean CValue objects of the same type `stride` bytes apart.
+     *
+     * All values are checked before the first one is written.
+     */
+    void write_array(const CType &type, b_lean_obj_arg values, size_t stride);
+
+    /** Copy `count` bytes to a new Lean ByteArray. */
+    lean_obj_res read_bytes(size_t count);
 
-    ~Pointer() {}
+    /** Copy the contents of a Lean ByteArray to the memory. */
+    void write_bytes(b_lean_obj_arg bytes) {
+        memcpy(pointer(), lean_sarray_cptr(bytes), lean_sarray_size(bytes));
+    }
+
+    /** Convert `count` values of a scalar type to a new Lean FloatArray. */
+    lean_obj_res read_floats(const CType &type, size_t count);
+
+    /** Convert the values of a Lean FloatArray to a scalar type in the memory. */
+    void write_floats(const CType &type, b_lean_obj_arg floats);
+
+    /** Call the pointer as a function with arrays of Lean CValue objects. */
+    lean_obj_res call(const CType &rtype, b_lean_obj_arg args, b_lean_obj_arg vargs);
 
-    /** Read a CType from the memory, creating a CValue. */
-    std::unique_ptr<CValue> read(const CType &type) {
-        return CValue::from_buffer(type, m_pointer);
+    /**
+     * Call the pointer as a function with an array of Lean Argument objects.
+     *
+     * Buffers are passed as pointers to their data. They are made exclusive first, so
+     * writes of the function are only visible in the returned array of arguments.
+     * Takes ownership of `args` and returns a CallResult object.
+     */
+    lean_obj_res call_with(const CType &rtype, lean_obj_arg args);
+
+    /**
+     * Call the pointer as a function `rtype f(argtype)` for every element of an array.
+     *
+     * The results are stored in another array. Both arrays are contiguous.
+     */
+    void map_call(const CType &rtype, const CType &argtype, const uint8_t *src,
+                  uint8_t *dst, size_t count) const;
+
+    /** Call the pointer as a function with an already prepared CIF. */
+    void call(ffi_cif *cif, void *rvalue, void **argvals) const {
+        LeanThread::enter();
+        ffi_call(cif, (void (*)())pointer(), rvalue, argvals);
     }
 
-    /** Write a value to the memory location. */
-    void write(const CValue &value) {
-        memcpy(m_pointer, value.to_buffer().get(), value.type()->size());
+    /** Call the pointer as a function with a direct call thunk. */
+    void call(DirectThunk thunk, void *rvalue, void **argvals,
+              const CType *const *types) const {
+        LeanThread::enter();
+        thunk(pointer(), rvalue, argvals, types);
     }
 
-    /** Call the pointer as a function. */
-    std::unique_ptr<CValue> call(CType &rtype,
-                                 std::vector<std::unique_ptr<CValue>> &args,
-                                 std::vector<std::unique_ptr<CValue>> &vargs);
+    /**
+     * Get the address of the buffer.
+     *
+     * Lazy symbols are looked up the first time. Raises an exception if the symbol
+     * doesn't exist.
+     */
+    uint8_t *pointer() const {
+        uint8_t *p = m_pointer.load(std::memory_order_acquire);
+        if (p == nullptr && !m_symbol.empty())
+            p = resolve();
+        return p;
+    }
 
-    /** Get the address of the buffer. */
-    uint8_t *pointer() const { return m_pointer; }
+    /**
+     * Create a pointer `delta` bytes after this one, wrapping around like `size_t`.
+     *
+     * The new pointer keeps the same owner alive. Offsets of lazy symbols that weren't
+     * looked up yet are lazy symbols themselves, so a failed lookup is reported when
+     * the new pointer is used.
+     */
+    Pointer *offset(size_t delta) const;
 
-    /** No children. */
-    const std::vector<lean_object *> children() { return {}; }
+    /** Get the address without a lookup, or nullptr if it isn't known yet. */
+    uint8_t *address() const { return m_pointer.load(std::memory_order_acquire); }
+
+    /** Check if the address is known without a lookup. */
+    bool resolved() const {
+        return m_symbol.empty() || m_pointer.load(std::memory_order_acquire);
+    }
+
+    /** The owner is the only child. */
+    const std::vector<lean_object *> children() {
+        if (m_owner)
+            return {m_owner};
+        return {};
+    }
 
   private:
-    // Address of the pointer.
-    uint8_t *m_pointer;
+    /**
+     * Call the pointer with the values in a frame.
+     *
+     * The first `nfixed` of the `nargs` arguments are the fixed arguments.
+     */
+    void call(const CType &rtype, const CType *const *types, size_t nfixed,
+              size_t nargs, CallFrame &frame) const;
+
+    /** Look up the symbol in the library and store the address. */
+    uint8_t *resolve() const;
+
+    // Address of the pointer, or nullptr if a lazy symbol wasn't looked up yet.
+    mutable std::atomic<uint8_t *> m_pointer;
+    // Object that owns the memory, e.g. a library, or nullptr.
+    lean_object *m_owner;
+    // Name of a lazy symbol in the library `m_owner`, or empty.
+    std::string m_symbol;
+    // Offset from the address of the lazy symbol.
+    size_t m_delta = 0;
 };
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "signature.hpp"
+#include <lean/lean.h>
+#include <stdexcept>
+
+std::mutex Signature::s_mutex;
+std::map<Signature::Key, std::weak_ptr<Signature>> Signature::s_signatures;
+
+/** Prepare the CIF. */
+Signature::Signature(const CType *rtype, const std::vector<const CType *> &argtypes)
+    : m_rtype(rtype), m_argtypes(argtypes) {
+    for (auto tp : m_argtypes)
+        m_ffi_argtypes.push_back(tp->ffitype());
+
+    ffi_status status = ffi_prep_cif(&m_cif, FFI_DEFAULT_ABI, m_argtypes.size(),
+                                     m_rtype->ffitype(), m_ffi_argtypes.data());
+    if (status != FFI_OK)
+        throw std::runtime_error("ffi_prep_cif() failed");
+}
+
+/**
+ * Get the signature for the types.
+ *
+ * Types are interned, so the addresses identify the signature.
+ */
+std::shared_ptr<Signature> Signature::get(const CType *rtype,
+                                          const std::vector<const CType *> &argtypes) {
+    Key key = {rtype};
+    key.insert(key.end(), argtypes.begin(), argtypes.end());
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (auto it = s_signatures.find(key); it != s_signatures.end()) {
+        if (auto signature = it->second.lock())
+            return signature;
+    }
+
+    // Remove the entries of deleted signatures before adding a new one.
+    for (auto it = s_signatures.begin(); it != s_signatures.end();) {
+        if (it->second.expired())
+            it = s_signatures.erase(it);
+        else
+            ++it;
+    }
+
+    std::shared_ptr<Signature> signature(new Signature(rtype, argtypes));
+    s_signatures[key] = signature;
+    return signature;
+}
+
+/** Number of signatures that are currently alive. */
+size_t Signature::count() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    size_t n = 0;
+    for (auto &[key, signature] : s_signatures)
+        n += !signature.expired();
+    return n;
+}
+
+/** Get the pool of the process. */
+ClosurePool &ClosurePool::global() {
+    // Never destroyed, because closures might be released at exit.
+    static ClosurePool *pool = new ClosurePool();
+    return *pool;
+}
+
+/** Get a closure and the address of its code. */
+ffi_closure *ClosurePool::acquire(void **code) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_available.empty()) {
+            Entry entry = m_available.back();
+            m_available.pop_back();
+            *code = entry.code;
+            return entry.closure;
+        }
+        m_allocated++;
+    }
+
+    auto closure = (ffi_closure *)ffi_closure_alloc(sizeof(ffi_closure), code);
+    if (closure == nullptr)
+        lean_internal_panic("ffi_closure_alloc() failed");
+    return closure;
+}
+
+/** Return a closure to the pool. */
+void ClosurePool::release(ffi_closure *closure, void *code) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_available.size() < MAX_AVAILABLE) {
+            m_available.push_back({closure, code});
+            return;
+        }
+        m_allocated--;
+    }
+    ffi_closure_free(closure);
+}
+
+/** Number of closures allocated with ffi_closure_alloc(). */
+size_t ClosurePool::allocated() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_allocated;
+}
+
+/** Number of closures in the pool. */
+size_t ClosurePool::available() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_available.size();
+}
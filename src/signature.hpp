@@ -0,0 +1,106 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "types.hpp"
+#include <cstddef>
+#include <ffi.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Prepared CIF of a closure signature.
+ *
+ * Signatures are shared by all closures with the same return and argument types.
+ * They are reference counted and deleted with the last closure that uses them.
+ */
+class Signature {
+  public:
+    Signature(const Signature &) = delete;
+    Signature &operator=(const Signature &) = delete;
+
+    /** Get the signature for the types, preparing it if necessary. */
+    static std::shared_ptr<Signature> get(const CType *rtype,
+                                          const std::vector<const CType *> &argtypes);
+
+    /** Number of signatures that are currently alive. */
+    static size_t count();
+
+    /** Get the prepared CIF. */
+    ffi_cif *cif() { return &m_cif; }
+
+    /** Get the return type. */
+    const CType *rtype() const { return m_rtype; }
+
+    /** Get the argument types. */
+    const std::vector<const CType *> &argtypes() const { return m_argtypes; }
+
+  private:
+    Signature(const CType *rtype, const std::vector<const CType *> &argtypes);
+
+    // Signatures by the return type followed by the argument types.
+    using Key = std::vector<const CType *>;
+    static std::mutex s_mutex;
+    static std::map<Key, std::weak_ptr<Signature>> s_signatures;
+
+    const CType *m_rtype;
+    std::vector<const CType *> m_argtypes;
+    // Argument types passed to the CIF. They have to outlive it.
+    std::vector<ffi_type *> m_ffi_argtypes;
+    ffi_cif m_cif;
+};
+
+/**
+ * Pool of libffi closures.
+ *
+ * ffi_closure_alloc() might map new executable pages. Released closures are kept
+ * and reused, so short-lived callbacks don't cost system calls.
+ */
+class ClosurePool {
+  public:
+    /** Get the pool of the process. */
+    static ClosurePool &global();
+
+    /** Get a closure and the address of its code. */
+    ffi_closure *acquire(void **code);
+
+    /** Return a closure to the pool. */
+    void release(ffi_closure *closure, void *code);
+
+    /** Number of closures allocated with ffi_closure_alloc(). */
+    size_t allocated();
+
+    /** Number of closures in the pool. */
+    size_t available();
+
+  private:
+    ClosurePool() : m_allocated(0) {}
+
+    // Maximum number of closures kept in the pool.
+    static constexpr size_t MAX_AVAILABLE = 1024;
+
+    struct Entry {
+        ffi_closure *closure;
+        void *code;
+    };
+
+    std::mutex m_mutex;
+    std::vector<Entry> m_available;
+    size_t m_allocated;
+};
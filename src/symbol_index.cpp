@@ -0,0 +1,134 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "symbol_index.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <dlfcn.h>
+#include <elf.h>
+#include <fnmatch.h>
+#include <link.h>
+#include <stdexcept>
+
+/**
+ * Get the number of entries in the symbol table from the GNU hash table.
+ *
+ * The table doesn't store the number, but the chain of the last bucket ends with the
+ * last symbol. See https://flapenguin.me/elf-dt-gnu-hash for the layout.
+ */
+static size_t gnu_hash_count(const uint32_t *table) {
+    uint32_t nbuckets = table[0];
+    uint32_t symoffset = table[1];
+    uint32_t bloom_size = table[2];
+    auto buckets = (const uint32_t *)((const ElfW(Addr) *)(table + 4) + bloom_size);
+    auto chain = buckets + nbuckets;
+
+    uint32_t last = 0;
+    for (uint32_t i = 0; i < nbuckets; i++)
+        last = std::max(last, buckets[i]);
+    if (last < symoffset)
+        return symoffset;
+
+    // The lowest bit marks the end of a chain.
+    while ((chain[last - symoffset] & 1) == 0)
+        last++;
+    return last + 1;
+}
+
+/** Read the dynamic symbol table of a loaded object. */
+SymbolIndex::SymbolIndex(void *handle) {
+    struct link_map *map;
+    if (dlinfo(handle, RTLD_DI_LINKMAP, &map) != 0)
+        throw std::runtime_error(std::string(dlerror()));
+
+    // Some architectures don't relocate the addresses in the dynamic section.
+    auto address = [&](ElfW(Addr) ptr) -> const void * {
+        return (const void *)(ptr < map->l_addr ? ptr + map->l_addr : ptr);
+    };
+
+    const ElfW(Sym) *symtab = nullptr;
+    const char *strtab = nullptr;
+    const uint32_t *hash = nullptr;
+    const uint32_t *gnu_hash = nullptr;
+    for (const ElfW(Dyn) *dyn = map->l_ld; dyn->d_tag != DT_NULL; dyn++) {
+        switch (dyn->d_tag) {
+        case DT_SYMTAB:
+            symtab = (const ElfW(Sym) *)address(dyn->d_un.d_ptr);
+            break;
+        case DT_STRTAB:
+            strtab = (const char *)address(dyn->d_un.d_ptr);
+            break;
+        case DT_HASH:
+            hash = (const uint32_t *)address(dyn->d_un.d_ptr);
+            break;
+        case DT_GNU_HASH:
+            gnu_hash = (const uint32_t *)address(dyn->d_un.d_ptr);
+            break;
+        }
+    }
+    if (!symtab || !strtab || !(hash || gnu_hash))
+        throw std::runtime_error("no dynamic symbol table");
+
+    // The SysV hash table stores the number of symbols in the chain size.
+    size_t count = hash ? hash[1] : gnu_hash_count(gnu_hash);
+    for (size_t i = 1; i < count; i++) {
+        const ElfW(Sym) &sym = symtab[i];
+        int bind = ELF64_ST_BIND(sym.st_info);
+        int type = ELF64_ST_TYPE(sym.st_info);
+        if (sym.st_shndx == SHN_UNDEF || sym.st_name == 0)
+            continue;
+        if (bind != STB_GLOBAL && bind != STB_WEAK && bind != STB_GNU_UNIQUE)
+            continue;
+        if (type != STT_FUNC && type != STT_OBJECT && type != STT_GNU_IFUNC &&
+            type != STT_COMMON && type != STT_TLS)
+            continue;
+        m_names.emplace_back(strtab + sym.st_name);
+    }
+
+    // Versioned symbols can appear more than once.
+    std::sort(m_names.begin(), m_names.end());
+    m_names.erase(std::unique(m_names.begin(), m_names.end()), m_names.end());
+}
+
+/** Get the exported names that start with `prefix`. */
+std::vector<std::string> SymbolIndex::with_prefix(const std::string &prefix) const {
+    std::vector<std::string> result;
+    auto it = std::lower_bound(m_names.begin(), m_names.end(), prefix);
+    for (; it != m_names.end() && it->starts_with(prefix); it++)
+        result.push_back(*it);
+    return result;
+}
+
+/**
+ * Get the exported names that match a glob pattern.
+ *
+ * Only the names that start with the literal prefix of the pattern are checked.
+ */
+std::vector<std::string> SymbolIndex::matching(const std::string &pattern) const {
+    std::string prefix = pattern.substr(0, pattern.find_first_of("*?[\\"));
+    std::vector<std::string> result;
+    auto it = std::lower_bound(m_names.begin(), m_names.end(), prefix);
+    for (; it != m_names.end() && it->starts_with(prefix); it++) {
+        if (fnmatch(pattern.c_str(), it->c_str(), 0) == 0)
+            result.push_back(*it);
+    }
+    return result;
+}
+
+/** Check if a name is exported. */
+bool SymbolIndex::contains(const std::string &name) const {
+    return std::binary_search(m_names.begin(), m_names.end(), name);
+}
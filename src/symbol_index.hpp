@@ -0,0 +1,53 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * Names of the symbols exported by a loaded shared object.
+ *
+ * The index is read once from the dynamic symbol table in memory, so queries don't
+ * call dlsym(). Names are sorted, which makes prefix queries and existence checks
+ * binary searches.
+ */
+class SymbolIndex {
+  public:
+    /**
+     * Read the exported symbols of the object that `handle` refers to.
+     *
+     * Raises an exception if the dynamic section can't be read.
+     */
+    explicit SymbolIndex(void *handle);
+
+    /** Get all exported names in sorted order. */
+    const std::vector<std::string> &names() const { return m_names; }
+
+    /** Get the exported names that start with `prefix`. */
+    std::vector<std::string> with_prefix(const std::string &prefix) const;
+
+    /** Get the exported names that match a glob pattern, see fnmatch(3). */
+    std::vector<std::string> matching(const std::string &pattern) const;
+
+    /** Check if a name is exported. */
+    bool contains(const std::string &name) const;
+
+  private:
+    // Sorted names without duplicates.
+    std::vector<std::string> m_names;
+};
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "thread.hpp"
+#include <lean/lean.h>
+
+namespace {
+
+/** State of the calling thread. */
+struct ThreadState {
+    // The thread is known to the Lean runtime.
+    bool known = false;
+    // The thread was registered by us and has to be unregistered.
+    bool registered = false;
+
+    ~ThreadState() {
+        if (registered)
+            lean_finalize_thread();
+    }
+};
+
+thread_local ThreadState t_state;
+
+} // namespace
+
+/** Remember that the calling thread is known to the Lean runtime. */
+void LeanThread::enter() { t_state.known = true; }
+
+/** Register the calling thread with the Lean runtime unless it is known. */
+void LeanThread::ensure() {
+    if (t_state.known)
+        return;
+
+    lean_initialize_thread();
+    t_state.known = true;
+    t_state.registered = true;
+}
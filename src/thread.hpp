@@ -0,0 +1,39 @@
+/*
+ * Copyright 2023 Alexander Fasching
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+/**
+ * Registration of native threads with the Lean runtime.
+ *
+ * Lean objects can only be allocated and callbacks can only be run on threads that
+ * are known to the runtime. Threads that call foreign functions from Lean are known
+ * already. Other threads, e.g. from a thread pool of a C library, are registered on
+ * their first callback and unregistered when they exit.
+ *
+ * Only threads that entered C through this library, e.g. with `Pointer.call` or a
+ * foreign function, or that created a closure are known. A Lean thread that enters C
+ * some other way and runs a callback there is treated like a foreign thread, which
+ * initializes its runtime state a second time.
+ */
+class LeanThread {
+  public:
+    /** Remember that the calling thread is known to the Lean runtime. */
+    static void enter();
+
+    /** Register the calling thread with the Lean runtime unless it is known. */
+    static void ensure();
+};
@@ -36,7 +36,7 @@ extern "C" lean_obj_res CType_alignment(b_lean_obj_arg type) {
 /** Get the offsets of a type. */
 extern "C" lean_obj_res CType_offsets(b_lean_obj_arg type) {
     auto tp = CType::unbox(type);
-    std::vector<size_t> offsets = tp->offsets();
+    auto &offsets = tp->offsets();
 
     lean_object *array = lean_alloc_array(offsets.size(), offsets.size());
     for (size_t i = 0; i < offsets.size(); i++)
@@ -15,65 +15,103 @@
  */
 
 #include "ctype.hpp"
+#include "../arena.hpp"
 #include "common.hpp"
+#include <algorithm>
 #include <ffi.h>
-#include <memory>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 /******************************************************************************
- * Shared methods for the base class and primitive types.
+ * Intern table for the descriptors.
  ******************************************************************************/
 
-/** Constructor for primitive types. */
-CType::CType(ObjectTag tag) : m_tag(tag) {
-    if (tag < STRUCT)
-        m_ffi_type = copy_ffi_type(ffi_type_map[tag]);
+/**
+ * Interned struct types.
+ *
+ * The element types are interned themselves, so two structs are equal if their
+ * element descriptors are the same objects. The key is a hash of the element
+ * addresses, which can be computed without allocating.
+ */
+static std::shared_mutex structs_mutex;
+static std::unordered_multimap<size_t, const CTypeStruct *> structs;
+
+/** Hash the addresses of the element descriptors. */
+static size_t hash_elements(std::span<const CType *const> elements) {
+    size_t hash = elements.size();
+    for (auto e : elements)
+        hash ^= std::hash<const CType *>()(e) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
 }
 
-CType::~CType() {
-    if (m_tag < STRUCT)
-        free_ffi_type(m_ffi_type);
+/** Find an interned struct. The caller has to hold the lock. */
+static const CTypeStruct *find_struct(size_t hash,
+                                      std::span<const CType *const> elements) {
+    auto [begin, end] = structs.equal_range(hash);
+    for (auto it = begin; it != end; it++) {
+        if (std::ranges::equal(it->second->elements(), elements))
+            return it->second;
+    }
+    return nullptr;
 }
 
-/** Create a deep copy of an ffi_type struct. */
-ffi_type *CType::copy_ffi_type(const ffi_type *tp) {
-    ffi_type *ntp = new ffi_type;
-
-    size_t n = 0;
-    while (tp->elements && tp->elements[n])
-        n++;
-
-    ntp->size = tp->size;
-    ntp->alignment = tp->alignment;
-    ntp->type = tp->type;
-    ntp->elements = new ffi_type *[n + 1]();
-    for (size_t i = 0; i < n; i++)
-        ntp->elements[i] = copy_ffi_type(tp->elements[i]);
-
-    return ntp;
+/** Get the descriptor of a primitive type. */
+const CType *CType::primitive(ObjectTag tag) {
+    // Same order as ObjectTag.
+    static const CTypePrimitive primitives[] = {
+        VOID,          INT8,           INT16,
+        INT32,         INT64,          UINT8,
+        UINT16,        UINT32,         UINT64,
+        FLOAT,         DOUBLE,         LONGDOUBLE,
+        COMPLEX_FLOAT, COMPLEX_DOUBLE, COMPLEX_LONGDOUBLE,
+        POINTER,
+    };
+    assert(tag < STRUCT);
+    return &primitives[tag];
 }
 
-/** Free a ffi_type struct. */
-void CType::free_ffi_type(ffi_type *tp) {
-    if (tp->elements) {
-        for (size_t i = 0; tp->elements[i]; i++)
-            free_ffi_type(tp->elements[i]);
-        delete[] tp->elements;
+/** Get the descriptor of a struct with the given element types. */
+const CType *CType::structure(std::span<const CType *const> elements) {
+    size_t hash = hash_elements(elements);
+    {
+        std::shared_lock lock(structs_mutex);
+        if (auto tp = find_struct(hash, elements))
+            return tp;
     }
-    delete tp;
+
+    // Another thread might have created the type in the meantime.
+    std::unique_lock lock(structs_mutex);
+    if (auto tp = find_struct(hash, elements))
+        return tp;
+    auto tp = new CTypeStruct(elements);
+    structs.emplace(hash, tp);
+    return tp;
 }
 
-/** Unbox the type into a CType class. */
-std::unique_ptr<CType> CType::unbox(b_lean_obj_arg obj) {
+/** Get the interned descriptor of a Lean CType object. */
+const CType *CType::unbox(b_lean_obj_arg obj) {
     ObjectTag tag = (ObjectTag)lean_obj_tag(obj);
     if (tag < STRUCT) {
-        return std::make_unique<CTypePrimitive>(tag);
+        return primitive(tag);
     } else if (tag == STRUCT) {
-        return std::make_unique<CTypeStruct>(lean_ctor_get(obj, 0));
+        lean_object *members = lean_ctor_get(obj, 0);
+        size_t n = lean_array_size(members);
+        FrameArena::Scope scope;
+        auto elements = FrameArena::local().alloc_array<const CType *>(n);
+        for (size_t i = 0; i < n; i++)
+            elements[i] = unbox(lean_array_get_core(members, i));
+        return structure({elements, n});
     } else {
         lean_internal_panic("unknown type");
     }
 }
 
+/******************************************************************************
+ * Shared methods for the base class and primitive types.
+ ******************************************************************************/
+
 /** Get the number of elements. */
 size_t CType::nelements() const {
     if (m_ffi_type->elements) {
@@ -85,59 +123,37 @@ size_t CType::nelements() const {
     return 0;
 }
 
-/** Get the array of struct offsets. */
-const std::vector<size_t> CType::offsets() const {
-    size_t n = nelements();
-    std::vector<size_t> offsets;
-
-    size_t offs[n];
-    ffi_status status = ffi_get_struct_offsets(FFI_DEFAULT_ABI, m_ffi_type, offs);
-
-    if (status == FFI_BAD_TYPEDEF)
-        return offsets;
-
-    if (status != FFI_OK)
-        lean_internal_panic("ffi_get_struct_offsets failed");
-
-    for (size_t i = 0; i < n; i++)
-        offsets.push_back(offs[i]);
-    return offsets;
+/** Types other than structs have no offsets. */
+const std::vector<size_t> &CType::offsets() const {
+    static const std::vector<size_t> empty;
+    return empty;
 }
 
 /******************************************************************************
  * Methods for the CTypeStruct type.
  ******************************************************************************/
 
-/** Create type from already existing and initialized types. */
-CTypeStruct::CTypeStruct(std::vector<std::unique_ptr<CType>> members)
-    : CType(STRUCT), m_element_types(std::move(members)) {
-    populate_ffi_type();
-}
+/** Create type from already interned element types. */
+CTypeStruct::CTypeStruct(std::span<const CType *const> elements)
+    : CType(STRUCT, new ffi_type()),
+      m_element_types(elements.begin(), elements.end()) {
+    m_ffi_type->type = FFI_TYPE_STRUCT;
+    m_ffi_type->elements = new ffi_type *[m_element_types.size() + 1]();
+    for (size_t i = 0; i < m_element_types.size(); i++)
+        m_ffi_type->elements[i] = m_element_types[i]->ffitype();
 
-/** Create type from a Lean array of CType types. */
-CTypeStruct::CTypeStruct(b_lean_obj_arg members) : CType(STRUCT) {
-    std::vector<std::unique_ptr<CType>> elements;
-    for (size_t i = 0; i < lean_array_size(members); i++) {
-        auto tp = CType::unbox(lean_array_get_core(members, i));
-        elements.push_back(std::move(tp));
-    }
-    m_element_types = std::move(elements);
-    populate_ffi_type();
+    // Initialize size and alignment fields and compute the offsets once.
+    m_offsets.resize(m_element_types.size());
+    ffi_status status =
+        ffi_get_struct_offsets(FFI_DEFAULT_ABI, m_ffi_type, m_offsets.data());
+    // Invalid types, e.g. empty structs, have no offsets.
+    if (status == FFI_BAD_TYPEDEF)
+        m_offsets.clear();
+    else if (status != FFI_OK)
+        lean_internal_panic("ffi_get_struct_offsets() failed");
 }
 
 CTypeStruct::~CTypeStruct() {
     delete[] m_ffi_type->elements;
     delete m_ffi_type;
 }
-
-/** Initialize the FFI type. */
-void CTypeStruct::populate_ffi_type() {
-    m_ffi_type = new ffi_type();
-    m_ffi_type->type = FFI_TYPE_STRUCT;
-    m_ffi_type->elements = new ffi_type *[m_element_types.size() + 1]();
-    for (size_t i = 0; i < m_element_types.size(); i++)
-        m_ffi_type->elements[i] = m_element_types[i]->ffitype();
-
-    // Initialize size and alignment fields.
-    ffi_get_struct_offsets(FFI_DEFAULT_ABI, m_ffi_type, nullptr);
-}
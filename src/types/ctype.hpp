@@ -19,18 +19,30 @@
 #include "common.hpp"
 #include <ffi.h>
 #include <lean/lean.h>
-#include <memory>
+#include <span>
 #include <vector>
 
+/**
+ * Descriptor of a C type.
+ *
+ * Descriptors are interned: structurally equal types share one immutable object,
+ * which lives until the process exits. Types can therefore be compared by address.
+ */
 class CType {
   public:
-    /** Basic constructor for the base type. */
-    CType(ObjectTag tag);
+    CType(const CType &) = delete;
+    CType &operator=(const CType &) = delete;
+
+    virtual ~CType() {}
 
-    virtual ~CType();
+    /** Get the interned descriptor of a Lean CType object. */
+    static const CType *unbox(b_lean_obj_arg obj);
 
-    /** Convert from Lean to this class. */
-    static std::unique_ptr<CType> unbox(b_lean_obj_arg obj);
+    /** Get the descriptor of a primitive type. */
+    static const CType *primitive(ObjectTag tag);
+
+    /** Get the descriptor of a struct with the given element types. */
+    static const CType *structure(std::span<const CType *const> elements);
 
     /** Get the size of the basic type. */
     size_t size() const { return m_ffi_type->size; }
@@ -41,20 +53,22 @@ class CType {
     /** Get the number of elements. */
     size_t nelements() const;
 
-    /** Get the array of struct offsets. */
-    const std::vector<size_t> offsets() const;
+    /**
+     * Get the offsets of the elements of a struct.
+     *
+     * They are computed once when the type is created. Other types have no offsets.
+     */
+    virtual const std::vector<size_t> &offsets() const;
 
     /** Get a pointer to the internal ffi_type. */
-    ffi_type *ffitype() { return m_ffi_type; }
+    ffi_type *ffitype() const { return m_ffi_type; }
 
     /** Get the tag of the CType. */
     ObjectTag tag() const { return m_tag; }
 
-  private:
-    static ffi_type *copy_ffi_type(const ffi_type *tp);
-    static void free_ffi_type(ffi_type *tp);
-
   protected:
+    CType(ObjectTag tag, ffi_type *type) : m_ffi_type(type), m_tag(tag) {}
+
     ffi_type *m_ffi_type;
 
   private:
@@ -64,32 +78,26 @@ class CType {
 /** Primitive types that are already defined in ffi.h. */
 class CTypePrimitive : public CType {
   public:
-    /** Basic constructor for the base type. */
-    CTypePrimitive(ObjectTag tag) : CType(tag) {}
+    /** Use the statically allocated ffi_type of libffi. */
+    CTypePrimitive(ObjectTag tag)
+        : CType(tag, const_cast<ffi_type *>(ffi_type_map[tag])) {}
 };
 
 /** Composite types that require manual construction. */
 class CTypeStruct : public CType {
   public:
-    /** Create type from already existing and initialized types. */
-    CTypeStruct(std::vector<std::unique_ptr<CType>> members);
-
-    /** Create type from a Lean array of CType types. */
-    CTypeStruct(b_lean_obj_arg members);
+    /** Create type from already interned element types. */
+    CTypeStruct(std::span<const CType *const> elements);
 
     ~CTypeStruct();
 
     /** Get elements in the struct. */
-    const std::vector<CType *> elements() const {
-        std::vector<CType *> elements;
-        for (auto &e : m_element_types)
-            elements.push_back(e.get());
-        return elements;
-    }
+    const std::vector<const CType *> &elements() const { return m_element_types; }
 
-  private:
-    /** Initialize the FFI type. */
-    void populate_ffi_type();
+    /** Get the offsets of the elements. */
+    const std::vector<size_t> &offsets() const override { return m_offsets; }
 
-    std::vector<std::unique_ptr<CType>> m_element_types;
+  private:
+    std::vector<const CType *> m_element_types;
+    std::vector<size_t> m_offsets;
 };
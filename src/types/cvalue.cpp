@@ -15,6 +15,7 @@
  */
 
 #include "cvalue.hpp"
+#include "../arena.hpp"
 #include "../pointer.hpp"
 #include <ffi.h>
 #include <memory>
@@ -108,6 +109,154 @@ std::unique_ptr<CValue> CValue::from_buffer(const CType &type, const uint8_t *bu
     lean_internal_panic_unreachable();
 }
 
+/** Get the type of a Lean CValue object without converting it. */
+const CType *CValue::type_of(b_lean_obj_arg obj) {
+    ObjectTag tag = (ObjectTag)lean_obj_tag(obj);
+    if (tag < STRUCT) {
+        return CType::primitive(tag);
+    } else if (tag == STRUCT) {
+        lean_object *values = lean_ctor_get(obj, 0);
+        size_t n = lean_array_size(values);
+        FrameArena::Scope scope;
+        auto types = FrameArena::local().alloc_array<const CType *>(n);
+        for (size_t i = 0; i < n; i++)
+            types[i] = type_of(lean_array_get_core(values, i));
+        return CType::structure({types, n});
+    } else {
+        lean_internal_panic("unknown tag");
+    }
+}
+
+/** Check if a Lean CValue object has the given type. */
+bool CValue::matches(const CType &type, b_lean_obj_arg obj) {
+    if (lean_obj_tag(obj) != type.tag())
+        return false;
+    if (type.tag() != STRUCT)
+        return true;
+
+    auto &elements = dynamic_cast<const CTypeStruct &>(type).elements();
+    lean_object *values = lean_ctor_get(obj, 0);
+    if (lean_array_size(values) != elements.size())
+        return false;
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (!matches(*elements[i], lean_array_get_core(values, i)))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Write a Lean CValue object directly to a buffer.
+ *
+ * Scalars are converted with temporary objects on the stack, so nothing is
+ * allocated on the heap except for the offsets of structs.
+ */
+void CValue::marshal(const CType &type, b_lean_obj_arg obj, uint8_t *buffer) {
+    assert(lean_obj_tag(obj) == type.tag());
+
+    switch (type.tag()) {
+    case VOID:
+        return CValueVoid().write(buffer);
+    case INT8:
+        return CValueInt<INT8>(obj).write(buffer);
+    case INT16:
+        return CValueInt<INT16>(obj).write(buffer);
+    case INT32:
+        return CValueInt<INT32>(obj).write(buffer);
+    case INT64:
+        return CValueInt<INT64>(obj).write(buffer);
+    case UINT8:
+        return CValueNat<UINT8>(obj).write(buffer);
+    case UINT16:
+        return CValueNat<UINT16>(obj).write(buffer);
+    case UINT32:
+        return CValueNat<UINT32>(obj).write(buffer);
+    case UINT64:
+        return CValueNat<UINT64>(obj).write(buffer);
+    case FLOAT:
+        return CValueFloat<FLOAT>(obj).write(buffer);
+    case DOUBLE:
+        return CValueFloat<DOUBLE>(obj).write(buffer);
+    case LONGDOUBLE:
+        return CValueFloat<LONGDOUBLE>(obj).write(buffer);
+    case COMPLEX_FLOAT:
+        return CValueComplex<COMPLEX_FLOAT>(obj).write(buffer);
+    case COMPLEX_DOUBLE:
+        return CValueComplex<COMPLEX_DOUBLE>(obj).write(buffer);
+    case COMPLEX_LONGDOUBLE:
+        return CValueComplex<COMPLEX_LONGDOUBLE>(obj).write(buffer);
+    case POINTER:
+        *((uint8_t **)buffer) = Pointer::unbox(lean_ctor_get(obj, 0))->pointer();
+        return;
+    case STRUCT: {
+        auto &elements = dynamic_cast<const CTypeStruct &>(type).elements();
+        auto &offsets = type.offsets();
+        lean_object *values = lean_ctor_get(obj, 0);
+        assert(lean_array_size(values) == elements.size());
+        for (size_t i = 0; i < elements.size(); i++)
+            marshal(*elements[i], lean_array_get_core(values, i), buffer + offsets[i]);
+        return;
+    }
+    default:
+        lean_internal_panic_unreachable();
+    }
+}
+
+/** Create a Lean CValue object directly from a buffer. */
+lean_obj_res CValue::unmarshal(const CType &type, const uint8_t *buffer) {
+    switch (type.tag()) {
+    case VOID:
+        return CValueVoid().box();
+    case INT8:
+        return CValueInt<INT8>(buffer).box();
+    case INT16:
+        return CValueInt<INT16>(buffer).box();
+    case INT32:
+        return CValueInt<INT32>(buffer).box();
+    case INT64:
+        return CValueInt<INT64>(buffer).box();
+    case UINT8:
+        return CValueNat<UINT8>(buffer).box();
+    case UINT16:
+        return CValueNat<UINT16>(buffer).box();
+    case UINT32:
+        return CValueNat<UINT32>(buffer).box();
+    case UINT64:
+        return CValueNat<UINT64>(buffer).box();
+    case FLOAT:
+        return CValueFloat<FLOAT>(buffer).box();
+    case DOUBLE:
+        return CValueFloat<DOUBLE>(buffer).box();
+    case LONGDOUBLE:
+        return CValueFloat<LONGDOUBLE>(buffer).box();
+    case COMPLEX_FLOAT:
+        return CValueComplex<COMPLEX_FLOAT>(buffer).box();
+    case COMPLEX_DOUBLE:
+        return CValueComplex<COMPLEX_DOUBLE>(buffer).box();
+    case COMPLEX_LONGDOUBLE:
+        return CValueComplex<COMPLEX_LONGDOUBLE>(buffer).box();
+    case POINTER: {
+        lean_object *o = lean_alloc_ctor(POINTER, 1, 0);
+        lean_ctor_set(o, 0, (new Pointer(*((uint8_t **)buffer)))->box());
+        return o;
+    }
+    case STRUCT: {
+        auto &elements = dynamic_cast<const CTypeStruct &>(type).elements();
+        auto &offsets = type.offsets();
+        lean_object *values = lean_alloc_array(elements.size(), elements.size());
+        for (size_t i = 0; i < elements.size(); i++) {
+            auto value = unmarshal(*elements[i], buffer + offsets[i]);
+            lean_array_set_core(values, i, value);
+        }
+        lean_object *o = lean_alloc_ctor(STRUCT, 1, 0);
+        lean_ctor_set(o, 0, values);
+        return o;
+    }
+    default:
+        lean_internal_panic_unreachable();
+    }
+}
+
 /** Create the value from a CValue object. */
 CValuePointer::CValuePointer(b_lean_obj_arg obj) : m_pointer(lean_ctor_get(obj, 0)) {
     assert(lean_obj_tag(obj) == POINTER);
@@ -119,8 +268,6 @@ CValuePointer::CValuePointer(const uint8_t *buffer)
     lean_inc(m_pointer);
 }
 
-std::unique_ptr<uint8_t[]> CValuePointer::to_buffer() const {
-    std::unique_ptr<uint8_t[]> buffer(new uint8_t[type()->size()]);
-    *((uint8_t **)buffer.get()) = Pointer::unbox(m_pointer)->pointer();
-    return buffer;
+void CValuePointer::write(uint8_t *buffer) const {
+    *((uint8_t **)buffer) = Pointer::unbox(m_pointer)->pointer();
 }
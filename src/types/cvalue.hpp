@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "../arena.hpp"
 #include "../utils.hpp"
 #include "common.hpp"
 #include "ctype.hpp"
@@ -25,13 +26,6 @@
 #include <memory>
 #include <vector>
 
-extern "C" LEAN_EXPORT lean_object *CValue_type__(lean_object *);
-/** Get the CType of a CValue. */
-static inline lean_object *CValue_type(lean_object *o) {
-    lean_inc(o);
-    return CValue_type__(o);
-}
-
 /** A pointer in C. */
 class Pointer;
 
@@ -49,16 +43,37 @@ class CValue {
     static std::unique_ptr<CValue> from_buffer(const CType &type,
                                                const uint8_t *buffer);
 
+    /** Get the type of a Lean CValue object without converting it. */
+    static const CType *type_of(b_lean_obj_arg obj);
+
+    /** Check if a Lean CValue object has the given type. */
+    static bool matches(const CType &type, b_lean_obj_arg obj);
+
+    /**
+     * Write a Lean CValue object directly to a buffer.
+     *
+     * The object must have the given type and the buffer must be large enough.
+     */
+    static void marshal(const CType &type, b_lean_obj_arg obj, uint8_t *buffer);
+
+    /** Create a Lean CValue object directly from a buffer. */
+    static lean_obj_res unmarshal(const CType &type, const uint8_t *buffer);
+
     /** Convert this class to a Lean object. */
     virtual lean_obj_res box() const = 0;
 
+    /** Write the value to a buffer with the size of the type. */
+    virtual void write(uint8_t *buffer) const = 0;
+
     /** Create a buffer for the value. */
-    virtual std::unique_ptr<uint8_t[]> to_buffer() const = 0;
+    std::unique_ptr<uint8_t[]> to_buffer() const {
+        std::unique_ptr<uint8_t[]> buffer(new uint8_t[type()->size()]);
+        write(buffer.get());
+        return buffer;
+    }
 
     /** Get the type of the value. */
-    virtual std::unique_ptr<CType> type() const {
-        return CType::unbox(CValue_type(box()));
-    }
+    virtual const CType *type() const = 0;
 };
 
 /**
@@ -69,10 +84,10 @@ class CValue {
 class CValueVoid : public CValue {
   public:
     lean_obj_res box() const override { return lean_box(0); }
-    std::unique_ptr<uint8_t[]> to_buffer() const override {
-        // Just create a buffer and set it to zero.
-        std::unique_ptr<uint8_t[]> buffer(new uint8_t[type()->size()]());
-        return buffer;
+    const CType *type() const override { return CType::primitive(VOID); }
+    void write(uint8_t *buffer) const override {
+        // Just set the buffer to zero.
+        memset(buffer, 0, type()->size());
     }
 };
 
@@ -83,11 +98,13 @@ template <ObjectTag Tag> class CValueScalar : public CValue {
   public:
     CValueScalar(T value) : m_value(value) {}
 
-    std::unique_ptr<uint8_t[]> to_buffer() const override {
-        std::unique_ptr<uint8_t[]> buffer(new uint8_t[type()->size()]);
-        *((T *)buffer.get()) = m_value;
-        return buffer;
-    }
+    /** The type only depends on the tag. */
+    const CType *type() const override { return CType::primitive(Tag); }
+
+    void write(uint8_t *buffer) const override { *((T *)buffer) = m_value; }
+
+    /** Get the C value. */
+    T value() const { return m_value; }
 
   protected:
     T m_value;
@@ -214,7 +231,9 @@ class CValuePointer : public CValue {
         return o;
     }
 
-    std::unique_ptr<uint8_t[]> to_buffer() const override;
+    void write(uint8_t *buffer) const override;
+
+    const CType *type() const override { return CType::primitive(POINTER); }
 
   private:
     // CValuePointer objects are different than scalars, because Pointer is an external
@@ -230,18 +249,23 @@ class CValueStruct : public CValue {
     CValueStruct(b_lean_obj_arg obj) {
         assert(lean_obj_tag(obj) == STRUCT);
         auto values = lean_ctor_get(obj, 0);
-        for (size_t i = 0; i < lean_array_size(values); i++) {
-            auto o = lean_array_uget(values, i); // Calls lean_inc()
+        size_t n = lean_array_size(values);
+        FrameArena::Scope scope;
+        auto types = FrameArena::local().alloc_array<const CType *>(n);
+        for (size_t i = 0; i < n; i++) {
+            auto o = lean_array_get_core(values, i);
             auto value = CValue::unbox(o);
+            types[i] = value->type();
             m_values.push_back(std::move(value));
         }
+        m_type = CType::structure({types, n});
     }
 
     /** Use type description to read a value from a buffer. */
-    CValueStruct(const CType &type, const uint8_t *buffer) {
+    CValueStruct(const CType &type, const uint8_t *buffer) : m_type(&type) {
         assert(type.tag() == STRUCT);
-        auto elements = dynamic_cast<const CTypeStruct &>(type).elements();
-        auto offs = type.offsets();
+        auto &elements = dynamic_cast<const CTypeStruct &>(type).elements();
+        auto &offs = type.offsets();
         assert(elements.size() == offs.size());
 
         for (size_t i = 0; i < elements.size(); i++) {
@@ -258,22 +282,18 @@ class CValueStruct : public CValue {
         return obj;
     }
 
-    std::unique_ptr<uint8_t[]> to_buffer() const override {
-        auto tp = type();
-        auto offsets = tp->offsets();
-        std::unique_ptr<uint8_t[]> buffer(new uint8_t[tp->size()]);
+    const CType *type() const override { return m_type; }
 
+    void write(uint8_t *buffer) const override {
+        auto &offsets = m_type->offsets();
         assert(m_values.size() == offsets.size());
-        for (size_t i = 0; i < m_values.size(); i++) {
-            auto off = offsets[i];
-            auto value = m_values[i]->to_buffer();
-            auto size = m_values[i]->type()->size();
-            memcpy(buffer.get() + off, value.get(), size);
-        }
-        return buffer;
+        for (size_t i = 0; i < m_values.size(); i++)
+            m_values[i]->write(buffer + offsets[i]);
     }
 
   private:
     /** Values in the struct. */
     std::vector<std::unique_ptr<CValue>> m_values;
+    /** Type derived from the values. */
+    const CType *m_type;
 };
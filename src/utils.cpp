@@ -15,6 +15,7 @@
  */
 
 #include "utils.hpp"
+#include "arena.hpp"
 #include "pointer.hpp"
 #include <cstdlib>
 #include <lean/lean.h>
@@ -35,3 +36,13 @@ extern "C" lean_obj_res Utils_free(b_lean_obj_arg pointer_obj) {
     free(Pointer::unbox(pointer_obj)->pointer());
     return lean_io_result_mk_ok(lean_box(0));
 }
+
+/** Get the statistics of the frame arena of the calling thread. */
+extern "C" lean_obj_res Utils_frameArenaStats(lean_object *unused) {
+    auto &arena = FrameArena::local();
+    lean_object *stats = lean_alloc_ctor(0, 3, 0);
+    lean_ctor_set(stats, 0, lean_usize_to_nat(arena.high_water()));
+    lean_ctor_set(stats, 1, lean_usize_to_nat(arena.overflows()));
+    lean_ctor_set(stats, 2, lean_usize_to_nat(arena.capacity()));
+    return lean_io_result_mk_ok(stats);
+}